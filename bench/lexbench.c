@@ -0,0 +1,92 @@
+// measures createPieces throughput in MB/s with each token boundary scanner the cpu supports
+// usage: mbasm_lexbench [file] [runs]
+// without a file a data heavy source of about 16MB is generated in a temporary file
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "types.h"
+#include "utility.h"
+#include "list.h"
+#include "error.h"
+#include "tokenscan.h"
+
+// write a synthetic source of roughly size bytes to a new temporary file and return its name
+static char* generateSource(size_t size){
+	static char name[] = "/tmp/mbasm_lexbenchXXXXXX";
+	int fd = mkstemp(name);
+	testError(fd < 0, "failed to create temporary file");
+	FILE* out = fdopen(fd, "w");
+	testError(!out, "failed to open temporary file");
+	size_t written = 0;
+	for(unsigned line = 0; written < size; ++line){
+		int n;
+		switch(line % 8){
+			case 0:
+				n = fprintf(out, ".label table_entry_%u\n", line);
+				break;
+			case 1:
+				n = fprintf(out, "\tlda table_entry_%u + %u +, x ; load from the table\n", line - 1, line % 200);
+				break;
+			case 2:
+				n = fprintf(out, ".const generated_constant_%u, 0x%X\n", line, line & 0xFFFF);
+				break;
+			case 3:
+				n = fprintf(out, ".string message_%u, \"generated message text number %u\"\n", line, line);
+				break;
+			default:
+				n = fprintf(out, "\t.drop16 generated_constant_%u + 0x10 + 2 <\n", line & ~7u);
+				break;
+		}
+		written += n;
+	}
+	testError(fclose(out), "failed to write temporary file");
+	return name;
+}
+
+static double now(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]){
+	char* name = argc > 1 ? argv[1] : generateSource(16 << 20);
+	int runs = argc > 2 ? atoi(argv[2]) : 5;
+	testError(runs < 1, "runs must be a positive number");
+
+	FILE* in = fopen(name, "rb");
+	testError(!in, "failed to open \"%s\"", name);
+	fseek(in, 0, SEEK_END);
+	double mb = ftell(in) / (1024.0 * 1024.0);
+	fclose(in);
+
+	printf("%s: %.1f MB, best of %d runs\n", name, mb, runs);
+	static const char* names[] = {"scalar", "sse2", "avx2"};
+	for(int a = 0; a < sizeof(names) / sizeof(names[0]); ++a){
+		if(!selectBoundaryScanner(names[a])){
+			printf("%-8s not supported\n", names[a]);
+			continue;
+		}
+		double best = 0;
+		size_t pieces = 0;
+		for(int r = 0; r < runs; ++r){
+			struct FileData f = newFileData(name);
+			double start = now();
+			createPieces(&f);
+			double t = now() - start;
+			if(!r || t < best){
+				best = t;
+			}
+			pieces = f.pieces.types.elementCount;
+			fileDataZero(&f);
+		}
+		printf("%-8s %8.1f MB/s  %zu pieces\n", names[a], mb / best, pieces);
+	}
+
+	if(argc <= 1){
+		unlink(name);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+// measures appending 16 byte elements to a List
+// usage: mbasm_listbench [count]
+// the step growth, per byte copy version of listAdd that List used to have is timed for comparison
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "types.h"
+#include "list.h"
+#include "error.h"
+
+// the old listAdd: grows by allocStep elements and copies each element byte by byte
+static void stepListAdd(struct List* list, const void* data, size_t count){
+	for(size_t dataidx = 0; dataidx < count; ++dataidx){
+		if(list->data == NULL || list->elementSize * list->elementCount >= list->bytesAllocated){
+			void* temp = realloc(list->data, list->bytesAllocated + list->allocStep * list->elementSize);
+			testError(!temp, "failed to reallocate space for list");
+			list->data = temp;
+			list->bytesAllocated += list->allocStep * list->elementSize;
+		}
+		unsigned char* insertPoint = (unsigned char*)list->data + list->elementCount * list->elementSize;
+		for(size_t byteidx = 0; byteidx < list->elementSize; ++byteidx){
+			insertPoint[byteidx] = ((unsigned char*)data)[byteidx + dataidx * list->elementSize];
+		}
+		++list->elementCount;
+	}
+}
+
+// a token as it was stored before the piece stream was split into parallel arrays
+struct Elem{
+	union{
+		size_t stridx;
+		int32_t integer;
+	};
+	enum PieceType type;
+};
+
+static double now(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// checksum the elements so the appends can't be optimized out and results can be compared
+static long sum(struct List* list){
+	long s = 0;
+	for(struct Elem* p = LIST_BEG(list, struct Elem); p != LIST_END(list, struct Elem); ++p){
+		s += p->integer + p->type;
+	}
+	return s;
+}
+
+int main(int argc, char* argv[]){
+	size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+	printf("appending %zu elements of %zu bytes\n", count, sizeof(struct Elem));
+
+	struct List list = listNew(sizeof(struct Elem), 100);
+	double start = now();
+	for(size_t a = 0; a < count; ++a){
+		struct Elem p = {.integer = a, .type = PT_INTEGER};
+		stepListAdd(&list, &p, 1);
+	}
+	printf("%-26s %8.3f s  checksum %ld\n", "old step growth", now() - start, sum(&list));
+	listZero(&list);
+
+	list = listNew(sizeof(struct Elem), 100);
+	start = now();
+	for(size_t a = 0; a < count; ++a){
+		struct Elem p = {.integer = a, .type = PT_INTEGER};
+		LIST_ADD(&list, struct Elem, &p, 1);
+	}
+	printf("%-26s %8.3f s  checksum %ld\n", "doubling", now() - start, sum(&list));
+	listZero(&list);
+
+	list = listNew(sizeof(struct Elem), 100);
+	start = now();
+	listReserve(&list, count);
+	for(size_t a = 0; a < count; ++a){
+		struct Elem p = {.integer = a, .type = PT_INTEGER};
+		LIST_ADD(&list, struct Elem, &p, 1);
+	}
+	printf("%-26s %8.3f s  checksum %ld\n", "reserved", now() - start, sum(&list));
+	listZero(&list);
+
+	// bulk append of a block of elements at a time
+	enum{BLOCK = 1024};
+	static struct Elem block[BLOCK];
+	list = listNew(sizeof(struct Elem), 100);
+	start = now();
+	for(size_t a = 0; a < count; a += BLOCK){
+		size_t n = count - a < BLOCK ? count - a : BLOCK;
+		for(size_t b = 0; b < n; ++b){
+			block[b].integer = a + b;
+			block[b].type = PT_INTEGER;
+		}
+		LIST_ADD(&list, struct Elem, block, n);
+	}
+	printf("%-26s %8.3f s  checksum %ld\n", "doubling, 1024 per add", now() - start, sum(&list));
+	listZero(&list);
+
+	return EXIT_SUCCESS;
+}
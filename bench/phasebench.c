@@ -0,0 +1,383 @@
+// times each phase of assembling a set of sources
+// usage: mbasm_bench [-f files] [-l lines] [-d density] [-c depth] [-r ratio] [-s seed] [-n runs] [sources...]
+// without sources, files synthetic sources of lines lines each are generated in a temporary directory:
+//   density is the fraction of lines that are labels
+//   depth is the length of each .CONST dependency chain
+//   ratio is the fraction of label references and .CONST chains that refer to something defined later
+// every run assembles in a forked process, so the global tables start empty each time
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "types.h"
+#include "utility.h"
+#include "list.h"
+#include "error.h"
+#include "commandeval.h"
+#include "link.h"
+#include "output.h"
+#include "memmap.h"
+#include "relax.h"
+
+enum Phase{
+	PH_LEX,
+	PH_SCAN,
+	PH_COMMANDS,
+	PH_LABELS,
+	PH_FIXUP,
+	PH_WRITE,
+	PH_COUNT
+};
+
+static const char* phaseNames[PH_COUNT] = {
+	[PH_LEX] = "createPieces",
+	[PH_SCAN] = "scanPieces",
+	[PH_COMMANDS] = "commandEval",
+	[PH_LABELS] = "labels",
+	[PH_FIXUP] = "fixups",
+	[PH_WRITE] = "write",
+};
+
+struct GenOptions{
+	int files;
+	int lines;
+	double density;
+	int depth;
+	double forward;
+	unsigned seed;
+};
+
+// what each generated line is, decided before writing so references can point forward
+enum LineKind{
+	LK_OTHER,	// an instruction or .DROP16
+	LK_LABEL,	// a .LABEL
+	LK_CHAIN,	// first line of a .CONST chain, the chain takes the following lines too
+};
+
+// bytes each generated file may place, the files together stay inside the image
+#define GEN_IMAGE_BUDGET 0x7000
+
+static unsigned long long rngState;
+
+static unsigned rng(void){
+	// xorshift64*
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return (rngState * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+static double rngUnit(void){
+	return rng() / 4294967296.0;
+}
+
+// write one synthetic source file, labelCounts has the number of labels of every file
+static void generateFile(const char* name, int fn, const struct GenOptions* o, const int* labelCounts, const uint8_t* kinds){
+	FILE* out = fopen(name, "w");
+	testError(!out, "failed to create \"%s\"", name);
+	if(fn == 0){
+		fprintf(out, ".label __START\n\tldx 0xff, i\n\ttxs\n.label __INTERRUPT\n\trti\n");
+	}
+	fprintf(out, ".alloc f%d_var, 2\n", fn);
+
+	int labels = 0, chains = 0, lastLabelLine = -100, fillers = 0;
+	size_t bytes = 0, budget = GEN_IMAGE_BUDGET / o->files;
+	for(int n = 0; n < o->lines; ++n){
+		if(kinds[n] == LK_LABEL){
+			fprintf(out, ".label f%d_l%d\n", fn, labels++);
+			lastLabelLine = n;
+			continue;
+		}
+
+		// a .CONST chain, each link adds 1 to the one before it
+		if(kinds[n] == LK_CHAIN){
+			bool reverse = rngUnit() < o->forward;
+			for(int a = 0; a < o->depth; ++a){
+				int j = reverse ? o->depth - 1 - a : a;
+				if(j == 0){
+					fprintf(out, ".const f%d_c%d_0, 3\n", fn, chains);
+				}else{
+					fprintf(out, ".const f%d_c%d_%d, f%d_c%d_%d + 1 +\n", fn, chains, j, fn, chains, j - 1);
+				}
+			}
+			++chains;
+			n += o->depth - 1;
+			continue;
+		}
+
+		// lines placing bytes become constants once the file used its part of the image
+		if(bytes + 3 > budget){
+			fprintf(out, ".const f%d_k%d, %d\n", fn, n, n);
+			++fillers;
+			continue;
+		}
+
+		// the label an instruction refers to, a later one in the file with the forward ratio, else an earlier one
+		// a few references go to a label of another file
+		char target[32] = "";
+		int tf = fn;
+		if(o->files > 1 && rng() % 10 == 0){
+			tf = rng() % o->files;
+		}
+		if(!labelCounts[tf]){
+			// nothing to refer to
+		}else if(tf != fn){
+			snprintf(target, sizeof(target), "f%d_l%d", tf, rng() % labelCounts[tf]);
+		}else if(labels < labelCounts[fn] && (labels == 0 || rngUnit() < o->forward)){
+			int ahead = labelCounts[fn] - labels;
+			snprintf(target, sizeof(target), "f%d_l%d", fn, labels + rng() % (ahead < 8 ? ahead : 8));
+		}else{
+			snprintf(target, sizeof(target), "f%d_l%d", fn, rng() % labels);
+		}
+		// with no label to refer to only implied instructions are used
+		unsigned r = target[0] ? rng() % 100 : 90;
+		if(r < 30){
+			fprintf(out, "\tlda %s\n", target);
+			bytes += 3;
+		}else if(r < 45){
+			fprintf(out, "\tjsr %s\n", target);
+			bytes += 3;
+		}else if(r < 55){
+			fprintf(out, "\tsta %s + 1 +, x\n", target);
+			bytes += 3;
+		}else if(r < 60){
+			fprintf(out, "\tlda f%d_var\n", fn);
+			bytes += 3;
+		}else if(r < 70 && chains){
+			fprintf(out, "\tlda f%d_c%d_%d, i\n", fn, rng() % chains, o->depth - 1);
+			bytes += 2;
+		}else if(r < 80 && n - lastLabelLine < 10){
+			fprintf(out, "\tbne f%d_l%d\n", fn, labels - 1);
+			bytes += 2;
+		}else if(r < 90){
+			fprintf(out, "\t.drop16 %s\n", target);
+			bytes += 2;
+		}else{
+			static const char* implied[] = {"nop", "inx", "txa", "dey"};
+			fprintf(out, "\t%s\n", implied[rng() % 4]);
+			bytes += 1;
+		}
+	}
+	testError(fclose(out), "failed to write \"%s\"", name);
+	if(fillers){
+		fprintf(stderr, "%s: image budget reached, %d lines written as constants instead\n", name, fillers);
+	}
+}
+
+// generate the sources into dir and return their names
+static char** generateSources(const char* dir, const struct GenOptions* o){
+	rngState = o->seed * 0x9E3779B97F4A7C15ULL + 1;
+	char** names = malloc(sizeof(char*) * o->files);
+	int* labelCounts = malloc(sizeof(int) * o->files);
+	uint8_t* kinds = calloc((size_t)o->files * o->lines, 1);
+	testError(!names || !labelCounts || !kinds, "generator alloc fail");
+
+	// about a tenth of the lines are in .CONST chains, density of the rest are labels
+	for(int fn = 0; fn < o->files; ++fn){
+		uint8_t* k = kinds + (size_t)fn * o->lines;
+		labelCounts[fn] = 0;
+		for(int n = 0; n < o->lines; ++n){
+			if(rngUnit() < 0.1 / o->depth && n + o->depth <= o->lines){
+				k[n] = LK_CHAIN;
+				n += o->depth - 1;
+			}else if(rngUnit() < o->density){
+				k[n] = LK_LABEL;
+				++labelCounts[fn];
+			}
+		}
+	}
+	for(int fn = 0; fn < o->files; ++fn){
+		testError((names[fn] = malloc(strlen(dir) + 32)) == NULL, "generator alloc fail");
+		sprintf(names[fn], "%s/f%d.s", dir, fn);
+		generateFile(names[fn], fn, o, labelCounts, kinds + (size_t)fn * o->lines);
+	}
+	free(labelCounts);
+	free(kinds);
+	return names;
+}
+
+static double now(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// assemble names into out and store the seconds each phase took in times
+static void assemble(char** names, int count, const char* out, double times[PH_COUNT]){
+	testError((memImage = calloc(ADDRESS_SPACE, 1)) == NULL, "image buffer alloc fail (%d bytes)", ADDRESS_SPACE);
+	defaultMemoryMap();
+	fillImage();
+	fssize = count;
+	testError((filesArray = malloc(sizeof(struct FileData) * fssize)) == NULL, "file list alloc fail");
+	for(int a = 0; a < fssize; ++a){
+		filesArray[a] = newFileData(names[a]);
+	}
+
+	double t = now();
+	for(int a = 0; a < fssize; ++a){
+		createPieces(filesArray + a);
+	}
+	times[PH_LEX] = now() - t;
+
+	t = now();
+	for(int a = 0; a < fssize; ++a){
+		beginPlacement();
+		int errorLine = scanPieces(filesArray + a);
+		if(errorLine){
+			addErrorMessage("from file \"%s\" on line %d", filesArray[a].name, errorLine);
+			printErrorsExit();
+		}
+		endPlacement(filesArray + a);
+	}
+	times[PH_SCAN] = now() - t;
+
+	t = now();
+	keepCommands();
+	if(!resolveCommands()){
+		printErrorsExit();
+	}
+	times[PH_COMMANDS] = now() - t;
+
+	t = now();
+	if(!checkDuplicateLabels() || !finalizeLabels() || !sizeInstructions()){
+		printErrorsExit();
+	}
+	times[PH_LABELS] = now() - t;
+
+	t = now();
+	if(!fixupInstructions()){
+		printErrorsExit();
+	}
+	times[PH_FIXUP] = now() - t;
+
+	t = now();
+	int start, interrupt;
+	placeVectors(&start, &interrupt);
+	writeImage(out);
+	times[PH_WRITE] = now() - t;
+}
+
+// temporary directory holding the generated sources and the output, removed when the bench exits
+static char tempDir[] = "/tmp/mbasm_benchXXXXXX";
+static char tempOut[sizeof(tempDir) + 16];
+static char** generated;
+static int generatedCount;
+static pid_t benchPid;
+
+static void removeTemp(void){
+	// forked runs exit through here too when assembling fails
+	if(getpid() != benchPid){
+		return;
+	}
+	for(int a = 0; a < generatedCount; ++a){
+		unlink(generated[a]);
+	}
+	unlink(tempOut);
+	rmdir(tempDir);
+}
+
+static int compareDouble(const void* a, const void* b){
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[]){
+	struct GenOptions o = {.files = 4, .lines = 4000, .density = 0.25, .depth = 8, .forward = 0.5, .seed = 1};
+	int runs = 5;
+	int opt;
+	while((opt = getopt(argc, argv, "f:l:d:c:r:s:n:")) != -1){
+		switch(opt){
+			case 'f':
+				o.files = atoi(optarg);
+				break;
+			case 'l':
+				o.lines = atoi(optarg);
+				break;
+			case 'd':
+				o.density = atof(optarg);
+				break;
+			case 'c':
+				o.depth = atoi(optarg);
+				break;
+			case 'r':
+				o.forward = atof(optarg);
+				break;
+			case 's':
+				o.seed = strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				runs = atoi(optarg);
+				break;
+			default:
+				simpleError("usage: %s [-f files] [-l lines] [-d density] [-c depth] [-r ratio] [-s seed] [-n runs] [sources...]", argv[0]);
+		}
+	}
+	testError(o.files < 1 || o.lines < 1 || o.depth < 1 || runs < 1, "files, lines, depth and runs must be positive numbers");
+	testError(o.density < 0 || o.density > 1 || o.forward < 0 || o.forward > 1, "density and ratio must be between 0 and 1");
+
+	testError(!mkdtemp(tempDir), "failed to create temporary directory");
+	sprintf(tempOut, "%s/out.bin", tempDir);
+	benchPid = getpid();
+	atexit(removeTemp);
+
+	// sources given on the command line are used as they are
+	char** names = argv + optind;
+	int count = argc - optind;
+	if(!count){
+		names = generated = generateSources(tempDir, &o);
+		count = generatedCount = o.files;
+	}
+	size_t sourceBytes = 0;
+	for(int a = 0; a < count; ++a){
+		FILE* in = fopen(names[a], "rb");
+		testError(!in, "failed to open \"%s\"", names[a]);
+		fseek(in, 0, SEEK_END);
+		sourceBytes += ftell(in);
+		fclose(in);
+	}
+	double* times = malloc(sizeof(double) * PH_COUNT * runs);
+	testError(!times, "times alloc fail");
+	for(int r = 0; r < runs; ++r){
+		int fds[2];
+		testError(pipe(fds), "failed to create pipe");
+		fflush(NULL);
+		pid_t pid = fork();
+		testError(pid < 0, "failed to fork");
+		if(!pid){
+			double t[PH_COUNT];
+			assemble(names, count, tempOut, t);
+			testError(write(fds[1], t, sizeof(t)) != sizeof(t), "failed to write phase times");
+			_exit(EXIT_SUCCESS);
+		}
+		close(fds[1]);
+		double t[PH_COUNT];
+		ssize_t got = read(fds[0], t, sizeof(t));
+		close(fds[0]);
+		int status;
+		waitpid(pid, &status, 0);
+		testError(!WIFEXITED(status) || WEXITSTATUS(status) || got != sizeof(t), "assembling failed");
+		// stored phase major so each phase can be sorted on its own
+		for(int p = 0; p < PH_COUNT; ++p){
+			times[p * runs + r] = t[p];
+		}
+	}
+
+	printf("%d files, %.1f KB of source, %d runs\n", count, sourceBytes / 1024.0, runs);
+	printf("%-14s %10s %10s\n", "phase", "best ms", "median ms");
+	double bestTotal = 0, medianTotal = 0;
+	for(int p = 0; p < PH_COUNT; ++p){
+		double* pt = times + p * runs;
+		qsort(pt, runs, sizeof(double), compareDouble);
+		bestTotal += pt[0];
+		medianTotal += pt[runs / 2];
+		printf("%-14s %10.3f %10.3f\n", phaseNames[p], pt[0] * 1e3, pt[runs / 2] * 1e3);
+	}
+	printf("%-14s %10.3f %10.3f\n", "total", bestTotal * 1e3, medianTotal * 1e3);
+
+	free(times);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+// bump allocator for data that lives until everything is released at once
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+struct ArenaBlock;
+
+// allocations are taken in order from the newest block, new blocks are added as needed
+struct Arena{
+	struct ArenaBlock* blocks;	// newest block first
+	size_t blockSize;		// minimum byte size of new blocks
+};
+
+// arena used for data shared by all files, like interned strings
+extern struct Arena globalArena;
+
+// create an empty arena that allocates blocks of at least blockSize bytes
+struct Arena newArena(size_t blockSize);
+
+// return pointer to size bytes from arena a, aligned for any type
+void* arenaAlloc(struct Arena* a, size_t size);
+
+// resize allocation p of oldSize bytes to newSize bytes and return its new location
+// the allocation grows in place if it is the newest one and there is space, otherwise it is copied
+// p may be NULL to allocate
+void* arenaGrow(struct Arena* a, void* p, size_t oldSize, size_t newSize);
+
+// make sure the next size bytes allocated from arena a come from a single block
+void arenaReserve(struct Arena* a, size_t size);
+
+// release every allocation from arena a
+void arenaZero(struct Arena* a);
+
+#endif
@@ -0,0 +1,26 @@
+// on disk cache of scanned files, so files that did not change are not lexed and scanned again
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "types.h"
+#include "stringmanip.h"
+
+// directory cache entries are kept in, NULL when caching is off
+extern const char* cacheDir;
+
+// return the cache key of file name, a hash of its contents and the assembler version
+uint64_t cacheKey(const char* name);
+
+// load the scan of file f cached under key, as if createPieces and scanPieces ran at relative address 0
+// strings go into the string table of the calling thread and bytes into memImage from 0, memIdx is set after them
+// returns false if there is no usable entry, f is left empty then
+bool cacheLoad(struct FileData* f, uint64_t key);
+
+// store the scan of file f under key, strings is the table it was scanned with and memImage holds memIdx bytes of it
+// failing to store an entry only means it is scanned again next time
+void cacheStore(const struct FileData* f, uint64_t key, const struct StringTable* strings);
+
+#endif
@@ -2,6 +2,25 @@
 #define COMMAND_EVAL_H
 
 #include "types.h"
-int commandEval(struct FileData* f);
+
+// address and value pairs of evaluated .SET commands, applied after everything else
+extern struct List setCommands;
+
+// a .CYCLES command with its addresses evaluated
+struct CycleCheck{
+	uint32_t file;		// index into filesArray of the file of the command
+	uint32_t from;		// handle of the expression for the address paths start at, for error messages
+	uint32_t to;		// same but for the address paths end at
+	int fromAddr;
+	int toAddr;
+	int max;		// most cycles a path can take
+};
+
+// struct CycleCheck for each evaluated .CYCLES command, checked by checkCycles once the image is finished
+extern struct List cycleChecks;
+
+// evaluate the commands of every file in filesArray, retrying a command only once the label it waits on is defined
+// returns true if every command was evaluated, otherwise adds error messages describing why and returns false
+bool resolveCommands(void);
 
 #endif
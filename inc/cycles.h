@@ -0,0 +1,16 @@
+// cycle counts of the finished image from the control flow between its instructions
+
+#ifndef CYCLES_H
+#define CYCLES_H
+
+#include <stdbool.h>
+
+// check the worst case cycles of every evaluated .CYCLES command against its limit, only paths that reach its to address count
+// call once the image is finished, returns false and adds error messages if a path takes more, can loop forever or none reaches the to address
+bool checkCycles(void);
+
+// print the best and worst case cycles from every code label to the end of its routine, and of taking the interrupt and running __INTERRUPT to its rti
+// a path ends at an rts, rti, brk, stp or jump that can't be followed, call once the image is finished
+void printCycles(void);
+
+#endif
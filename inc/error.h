@@ -5,9 +5,9 @@
 
 #include "list.h"
 
-// both defined in error.c
-extern struct List errorList; // list used to store strings for errors
-extern int errorLine; // variable to use to represent the line an error was found
+// both defined in error.c, each thread has its own messages
+extern _Thread_local struct List errorList; // list used to store strings for errors
+extern _Thread_local int errorLine; // variable to use to represent the line an error was found
 
 // adds an error message formatted like printf with format string s to the message stack
 // messages are printed in reverse order, so functions should add their error message before returning erros
@@ -27,4 +27,10 @@ void printErrorsExit(void) __attribute__((noreturn));
 // clears the messages currently added
 void clearErrors(void);
 
+// remove the messages added on the calling thread and return them, used to hand messages to another thread
+struct List takeErrors(void);
+
+// add messages returned by takeErrors after the ones currently added and free them
+void putErrors(struct List msgs);
+
 #endif
@@ -0,0 +1,30 @@
+// expressions compiled once from pieces and evaluated without allocating
+
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "types.h"
+
+// handle of no expression, handle 0 is reserved in every file
+#define EXPR_NONE 0
+
+// string id of the label that was not defined when evalExpression last failed
+extern _Thread_local size_t missingLabel;
+
+// compile the expression starting at piece p of file f into the code list of f and return its handle
+// returns EXPR_NONE and adds an error message if the expression has pieces that can't be evaluated
+size_t compileExpression(size_t p, struct FileData* f);
+
+// remove expression handle expr and everything compiled after it from file f
+void dropExpressions(struct FileData* f, size_t expr);
+
+// evaluate expression handle expr of file f and store the result in *res
+// returns false and adds an error message if a label used is not defined yet
+bool evalExpression(struct FileData* f, size_t expr, int* res);
+
+// return index of the first source piece of expression handle expr of file f, for error messages
+size_t exprPieces(struct FileData* f, size_t expr);
+
+#endif
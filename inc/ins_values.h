@@ -48,11 +48,20 @@
  *	2) if indirect, immediate, or indexed addressing is used
  *	3) and an extra specifier for indirect or indexed addressing
  * if the values being compared match the values at an index N, then the Nth addressing mode enum is the correct one to use
+ *
+ * opcodeCycles is an array of the number of cycles each opcode takes on the 65C02, indexed by opcode value
+ * the low 4 bits are the cycles the opcode always takes, and the CYCLES_ flags below are the cycles it can take on top of those
+ * entries for opcode values that are not valid instructions are 0
  */
 
 extern const char* insNameStrings[];
 extern const short opcodes[][16];
 extern const char flagsList[][3];
+extern const unsigned char opcodeCycles[256];
+
+#define CYCLES_MASK	0x0F	// cycles the opcode always takes
+#define CYCLES_PAGE	0x10	// 1 more cycle if indexing crosses a page
+#define CYCLES_BRANCH	0x20	// 1 more cycle if the branch is taken, and 1 more if it goes to another page
 
 #define OPC_ADC_ZPII	0x61
 #define OPC_ADC_ZP	0x65
@@ -0,0 +1,30 @@
+// parallel lexing and scanning of input files
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+
+// create and scan the pieces of every file in filesArray using up to jobs threads
+// each file is scanned into its own image and string table, then merged in file order
+// the result is the same as calling createPieces and scanPieces on each file in order
+// files with an entry in the cache directory are loaded from it instead, see cache.h
+// exits with the error messages of the first file in order that failed
+void scanFilesParallel(int jobs);
+
+// the two halves of scanFilesParallel, files scanned by scanFiles stay at relative addresses until mergeFiles
+void scanFiles(int jobs);
+void mergeFiles(void);
+
+// load every file in filesArray as an object file written by writeObject instead of scanning it, then merge with mergeFiles
+// exits if a file is not an object or a label an object uses is not defined by any of them
+void loadObjects(void);
+
+// write the scan of file fn as an object file with name, exits with its error messages if the scan failed
+void writeObject(int fn, const char* name);
+
+// scan file fn again in a child process after scanFiles and before mergeFiles, replacing its previous scan
+// returns false and keeps the previous scan if the file has errors, the child prints them, so a bad file never exits the caller
+bool rescanFile(int fn);
+
+#endif
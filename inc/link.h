@@ -0,0 +1,40 @@
+// phases after every file is scanned and its commands are evaluated, which put the final image together
+
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "list.h"
+
+// addresses [start, end) of a part of a rom segment that holds placed bytes
+struct ImageRange{
+	uint32_t start;
+	uint32_t end;
+	uint32_t offset;	// where start is in the output
+};
+
+// struct ImageRange for each part of the image holding placed bytes, sorted and not touching each other in a segment
+// set by placeVectors, everything outside of them holds the fill value of its segment
+extern struct List imageRanges;
+
+// add error messages for every label name defined more than once
+// returns false if there were any
+bool checkDuplicateLabels(void);
+
+// give allocations their address in the ram segment of their file, every label is LT_DEFINED after
+// returns false and adds error messages if an allocation does not fit
+bool finalizeLabels(void);
+
+// evaluate the relocations of every file and place the values in the image
+// returns false and adds error messages if an expression can't be evaluated or its value does not fit
+bool fixupInstructions(void);
+
+// place the reset and interrupt vectors and then apply .SET commands over the image, then find imageRanges and the used rom segments
+// stores the addresses of the __START and __INTERRUPT labels in *start and *interrupt, exits if either is missing
+void placeVectors(int* start, int* interrupt);
+
+// run every phase above in order on the scanned files, exiting with the error messages of the first one that fails
+void linkFiles(int* start, int* interrupt);
+
+#endif
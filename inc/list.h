@@ -2,32 +2,69 @@
 #define LIST_H
 
 #include <stddef.h>
+#include <assert.h>
+
+struct Arena;
 
 // dynamic array-like structure that allows element insertion at the end and random access
+// the array doubles in size when it runs out of space, so adding n elements copies O(n) bytes in total
 struct List{
 	size_t elementCount;	// number of elements in array
 	size_t elementSize;	// size in bytes of each element
-	size_t bytesAllocated;	// number of elements memory has been allocated for
-	size_t allocStep;	// number of extra elements to allocate after space runs out
+	size_t bytesAllocated;	// number of bytes memory has been allocated for
+	size_t allocStep;	// minimum number of elements to allocate when space runs out
 	void* data;		// pointer to the array
+	struct Arena* arena;	// arena the array is allocated from, NULL for the heap
 };
 
 // create a new list with some elements and set elementSize
 struct List listNew(size_t elemSize, size_t alloc);
 
 // add count element from data to list
+// if data is NULL the new elements are left uninitialized
 void listAdd(struct List* list, const void* data, size_t count);
 
-// return pointer to the data array at index idx (with respect to element byte size)
-void* listAt(struct List list, size_t idx);
+// make sure there is space for at least count elements in total
+void listReserve(struct List* list, size_t count);
+
+// allocate the array of list from arena a from now on, moving the elements already added
+void listUseArena(struct List* list, struct Arena* a);
+
+// free memory allocated and reset length and allocated count
+// memory from an arena is only released with the arena
+void listZero(struct List* list);
+
+// return pointer to the data array at index idx (with respect to element byte size), NULL if out of range
+static inline void* listAt(const struct List* list, size_t idx){
+	if(!list->data || idx >= list->elementCount){
+		return NULL;
+	}
+	return (unsigned char*)list->data + idx * list->elementSize;
+}
 
 // return pointer to the beginning of the array
-void* listBeg(struct List list);
+static inline void* listBeg(const struct List* list){
+	return list->data;
+}
 
 // return pointer to the end of the array
-void* listEnd(struct List list);
+static inline void* listEnd(const struct List* list){
+	// return NULL if no data or end
+	return list->data == NULL ? NULL : (unsigned char*)list->data + list->elementSize * list->elementCount;
+}
 
-// free memory allocated and reset length and allocated count
-void listZero(struct List* list);
+// return list after checking in debug builds that its elements are elemSize bytes, used by the typed macros
+static inline const struct List* listTyped(const struct List* list, size_t elemSize){
+	assert(list->elementSize == elemSize);
+	return list;
+}
+
+// typed versions of the accessors, list is a pointer and type is the element type
+#define LIST_AT(list, type, idx) ((type*)listAt(listTyped((list), sizeof(type)), (idx)))
+#define LIST_BEG(list, type) ((type*)listBeg(listTyped((list), sizeof(type))))
+#define LIST_END(list, type) ((type*)listEnd(listTyped((list), sizeof(type))))
+
+// typed add of count elements from ptr, ptr must convert to a pointer to const type
+#define LIST_ADD(list, type, ptr, count) listAdd(((void)listTyped((list), sizeof(type)), (list)), (const type*){(ptr)}, (count))
 
 #endif
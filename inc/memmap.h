@@ -0,0 +1,61 @@
+// memory map of the target, the rom segments code and data are placed in and the ram segments .ALLOC takes space from
+
+#ifndef MEMMAP_H
+#define MEMMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "types.h"
+#include "list.h"
+
+// a range of addresses with a name
+struct Segment{
+	char* name;		// upper case like the names in sources
+	uint32_t start;		// first address
+	uint32_t size;		// bytes from start
+	uint32_t next;		// rom: address the next file placed in it starts at, ram: address of the next allocation
+	uint32_t offset;	// rom: where its bytes start in the output, set by placeVectors
+	uint8_t fill;		// rom: value of the bytes nothing is placed at
+	bool rom;		// rom segments are written to the output, ram segments are not
+	bool used;		// rom: something was placed in it, only used segments are written to the output
+};
+
+// struct Segment for each segment in the order of the map, files go in the first rom segment and allocate from the first ram segment unless they choose others
+extern struct List segments;
+
+// read the memory map from file name, exits with an error message at the first line that is not valid
+// each line is: name rom|ram start size [fill], # starts a comment
+void loadMemoryMap(const char* name);
+
+// use a rom segment at 0x8000 of 0x8000 bytes and a ram segment from 0x200 up to it if no map was loaded
+void defaultMemoryMap(void);
+
+// fill the rom segments of memImage with their fill values
+void fillImage(void);
+
+// return the index of the segment named name, -1 if there is none
+int findSegment(const char* name);
+
+// return the rom segment holding addresses [address, address + size), NULL if none holds them all
+struct Segment* romSegmentAt(uint32_t address, uint32_t size);
+
+// return the rom segment and ram segment file f was placed in
+struct Segment* fileRomSegment(const struct FileData* f);
+struct Segment* fileRamSegment(const struct FileData* f);
+
+// set the segments of f from its .SEGMENT commands, exits if one names a segment that is not in the map
+void assignSegments(struct FileData* f);
+
+// place the files scanned in order from memIdx at their final address on the calling thread
+// beginPlacement sets memIdx to the end of the default rom segment, .SEGMENT moves it to the end of the one named
+// endPlacement ends file f there and exits if it does not fit
+void beginPlacement(void);
+void endPlacement(struct FileData* f);
+
+// set memIdx to the end of rom segment seg if files are placed while scanning, see beginPlacement
+void placeInSegment(int seg);
+
+// return the address file f of size bytes starts at, at the end of its rom segment, exits if it does not fit
+uint32_t placeFile(struct FileData* f, uint32_t size);
+
+#endif
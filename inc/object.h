@@ -0,0 +1,37 @@
+// scans of single files stored on disk, as cache entries and as relocatable object files
+// a scan is everything createPieces and scanPieces produce for a file at relative address 0 with its own string table:
+// the bytes it places (its section), its records, and the expressions of instructions and commands still to be evaluated
+// those expressions are the relocations, they are evaluated once the file is merged at its final address
+
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "types.h"
+#include "stringmanip.h"
+
+#define SCAN_CACHE "MBIR"	// cache entry, see cache.h
+#define SCAN_OBJECT "MBOB"	// object file written with -c
+
+// symbols of a scan, string ids are local to the scan
+struct ScanSymbols{
+	struct List source;	// name of the source file, nul terminated
+	struct List exports;	// uint32_t string ids of the labels the file defines
+	struct List imports;	// uint32_t string ids of the labels the file uses but does not define
+};
+
+// write the scan of file f to file name, strings is the table it was scanned with and image holds the size bytes it placed
+// kind is SCAN_CACHE or SCAN_OBJECT, key is stored to be checked by readScan
+// the file is written under a temporary name and renamed, returns false if it could not be written
+bool writeScan(const char* name, const char* kind, uint64_t key, const struct FileData* f, const struct StringTable* strings, const unsigned char* image, size_t size);
+
+// load the scan stored in file name into f, image and *size, the strings go into the string table of the calling thread
+// the symbols are stored in *symbols if it is not NULL, free them with scanSymbolsZero
+// returns false if the file can't be read or is not a scan of kind with key, f is left empty then
+bool readScan(const char* name, const char* kind, uint64_t key, struct FileData* f, unsigned char* image, size_t* size, struct ScanSymbols* symbols);
+
+void scanSymbolsZero(struct ScanSymbols* s);
+
+#endif
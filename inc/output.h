@@ -0,0 +1,28 @@
+// writers for the finished image in the formats eeprom programmers and emulators take
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdbool.h>
+
+enum OutputFormat{
+	OF_BIN,		// every used rom segment as raw bytes
+	OF_IHEX,	// intel hex records of the placed ranges
+	OF_SREC,	// motorola s-records of the placed ranges
+	OF_CARRAY,	// c source with an array for each placed range
+};
+
+// format writeImage uses, OF_BIN unless set with setOutputFormat
+extern enum OutputFormat outputFormat;
+
+// set outputFormat from its name as given to --format, returns false if no format has that name
+bool setOutputFormat(const char* name);
+
+// write the image to file name in outputFormat, only the bytes in imageRanges are written unless it is OF_BIN
+// addresses in the file are offsets in the output, where the used rom segments follow each other, exits on failure
+void writeImage(const char* name);
+
+// print every byte of the used rom segments to stdout as comma separated hex values
+void listImage(void);
+
+#endif
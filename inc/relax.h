@@ -0,0 +1,35 @@
+// changes of instruction sizes once the values of labels are known, and moving everything after them
+
+#ifndef RELAX_H
+#define RELAX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ins_values.h"
+
+// true if optimizeInstructions rewrites instructions, set by -O
+extern bool optimizeCode;
+
+// return the zero page form of absolute addressing mode mode, AM_NULL if it has none
+enum AddressingMode zeroPageMode(enum AddressingMode mode);
+
+// copy the commands of every file if an instruction may change size or optimizeCode is set, sizeInstructions evaluates them again from the copies
+// call before resolveCommands
+void keepCommands(void);
+
+// if optimizeCode is set, rewrite slow instruction sequences of every file to faster ones
+// jsr x, rts becomes jmp x, a branch to a jmp goes to its target, lda #0 and stores of a become stz when a is loaded again after,
+// a clc or sec followed by another is removed, and a jmp with its target in reach becomes bra
+// code after removed bytes moves as in sizeInstructions, call after finalizeLabels and before sizeInstructions
+bool optimizeInstructions(void);
+
+// print how often each rewrite of optimizeInstructions was made and the bytes and cycles it saved
+void printOptimizations(void);
+
+// shrink absolute instructions whose value turns out to be a zero page address to their zero page form
+// and grow branches whose target is out of reach, bra to jmp and other branches to the inverted branch over a jmp
+// moves the code, data and labels after each one and evaluates the commands again, until no more instructions change
+// call after finalizeLabels, returns false and adds error messages if the commands fail to evaluate again
+bool sizeInstructions(void);
+
+#endif
@@ -0,0 +1,20 @@
+// cycle counting 65C02 simulator that runs the finished image and profiles it by label
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// stub the addresses given by spec as start[-end][=value], reads of them give value or 0 and writes to them are dropped
+// returns false if spec is not in that form
+bool addStub(const char* spec);
+
+// run the image from the reset vector for at most cycles cycles, or until stp, wai or an opcode that is not valid
+// then print the cycles spent at each code label, the cycles spent in the calls made from it and how often it was called
+// folded names a file to write the folded call stacks of the run to for flame graphs, or is NULL
+// exits with an error if the image has bbr or bbs, which the assembler encodes without their zero page address
+// call once the image is finished
+void runImage(uint64_t cycles, const char* folded);
+
+#endif
@@ -0,0 +1,47 @@
+// counters for --stats, only compiled in when MBASM_STATS is defined (cmake -DMBASM_STATS=ON)
+// without it the STAT macros expand to nothing so the hot paths are unchanged
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef MBASM_STATS
+
+// counted on each thread and added together by statsFlush
+struct Stats{
+	uint64_t evalCalls;		// calls to evalExpression
+	uint64_t labelLookups;		// labels looked up by evalExpression
+	uint64_t stringHits;		// addString calls that found the string already added
+	uint64_t stringMisses;		// addString calls that added a new string
+	uint64_t commandAttempts;	// command evaluations tried
+	uint64_t commandsFirst;		// commands resolved on their first attempt
+	uint64_t commandsRetried;	// commands resolved after waiting on a label
+	uint64_t cacheHits;		// files loaded from the cache
+	uint64_t cacheMisses;		// files scanned because the cache had no usable entry
+	uint64_t errorBytes;		// peak bytes held by the error message list
+};
+
+extern _Thread_local struct Stats stats;
+
+#define STAT_ADD(counter, n) (stats.counter += (n))
+#define STAT_MAX(counter, v) (stats.counter = (v) > stats.counter ? (v) : stats.counter)
+
+#else
+
+#define STAT_ADD(counter, n) ((void)0)
+#define STAT_MAX(counter, v) ((void)0)
+
+#endif
+
+// true if the counters are compiled in
+extern const int statsAvailable;
+
+// add the counters of the calling thread to the totals and reset them
+void statsFlush(void);
+
+// print the totals and the memory held by the lists of every file to stdout
+void printStats(void);
+
+#endif
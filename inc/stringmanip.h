@@ -1,9 +1,39 @@
 #ifndef STRING_MANIP_H
 #define STRING_MANIP_H
 
+#include <stddef.h>
+#include "list.h"
+
+// interned strings, each string is identified by an id given in order of first addition
+struct StringTable{
+	struct List chars;	// all strings back to back, each nul terminated
+	struct List offsets;	// offset of each string start in chars, indexed by string id
+	int* table;		// open addressing hash table of string ids + 1, 0 marks an empty slot
+	size_t tableCap;	// capacity of table, always a power of 2 and kept at most half full
+};
+
 int strToInt(const char s[], int len);
+
+// create an empty string table
+struct StringTable newStringTable(void);
+
+// free memory allocated by table t
+void stringTableZero(struct StringTable* t);
+
+// make t the table used by the string functions on the calling thread and return the previous one
+// NULL selects the global table, which every thread uses by default
+struct StringTable* useStrings(struct StringTable* t);
+
+// return the number of bytes held by the table used on the calling thread
+size_t stringTableBytes(void);
+
+// return pointer to the string with id i, NULL if no such string
 char* stringAt(int i);
-int findString(char* c, int s);
-int addString(char* c, int s);
+
+// return the id of the string of s characters from c if interned, otherwise -(number of strings + 1)
+int findString(const char* c, int s);
+
+// intern the string of s characters from c and return its id, reusing the existing id if present
+int addString(const char* c, int s);
 
 #endif
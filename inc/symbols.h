@@ -0,0 +1,22 @@
+// global symbol table mapping interned label names to the labels defined in each file
+
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stddef.h>
+#include "types.h"
+
+// add label l to the labels of file f and register it in the symbol table under its name
+// if a label with the same name is already registered, the first one stays registered
+void addLabel(struct FileData* f, struct Label l);
+
+// forget every registered label, the labels lists of the files must be emptied too
+void clearLabels(void);
+
+// return pointer to the label registered with string id name, NULL if there is none
+struct Label* findLabel(size_t name);
+
+// return pointer to the file of the label registered with string id name, NULL if there is none
+struct FileData* labelFile(size_t name);
+
+#endif
@@ -0,0 +1,22 @@
+// finding token boundaries in source text several characters at a time
+
+#ifndef TOKEN_SCAN_H
+#define TOKEN_SCAN_H
+
+#include <stdbool.h>
+
+// true for every character that can end a token or literal: symbol characters, ';', '\0', space and tab
+extern const bool isBoundary[256];
+
+// return pointer to the first boundary character from c before end, end if there is none
+// uses the widest implementation the cpu supports unless another was selected
+const char* findBoundary(const char* c, const char* end);
+
+// select the implementation used by findBoundary by name: "scalar", "sse2" or "avx2"
+// returns false and keeps the current one if the name is unknown or not supported by the cpu
+bool selectBoundaryScanner(const char* name);
+
+// return the name of the implementation used by findBoundary
+const char* boundaryScannerName(void);
+
+#endif
@@ -0,0 +1,21 @@
+// timeline of assembler phases written in the chrome trace event format, viewable in chrome://tracing or perfetto
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+// true once traceOpen was called, events are only recorded then
+extern bool traceEnabled;
+
+// start recording events, they are written to file name when the program exits
+void traceOpen(const char* name);
+
+// record the beginning of phase name on the calling thread, file is the input file it works on or NULL
+// name and file must stay valid until the program exits
+void traceBegin(const char* name, const char* file);
+
+// record the end of the phase last begun on the calling thread
+void traceEnd(void);
+
+#endif
@@ -7,13 +7,27 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "list.h"
+#include "arena.h"
+
+// pieces of a file stored as parallel arrays, piece n is types[n] with payload values[n]
+// scanning mostly looks at types only, so keeping them apart packs many more per cache line
+struct PieceStream{
+	struct List types;	// uint8_t enum PieceType of each piece
+	struct List values;	// uint32_t string id or int32_t integer of each piece, unused for symbols
+};
 
 struct FileData{
 	const char* name;
-	struct List pieces;
+	struct PieceStream pieces;
 	struct List labels;
 	struct List instructions;
+	struct List relocs;	// struct Reloc for each instruction value placed once its expression can be evaluated
 	struct List commands;
+	struct List exprs;	// compiled expressions, indexed by expression handle
+	struct List code;	// steps of all compiled expressions
+	struct Arena arena;	// backs the lists above once the file size is known, see fileDataUseArena
+	int16_t romSegment;	// index of the segment the file is placed in, -1 for the first rom segment of the map
+	int16_t ramSegment;	// index of the segment its allocations are taken from, -1 for the first ram segment
 };
 
 // part of every piece struct, indentifies what data is in the union of each piece
@@ -31,32 +45,56 @@ enum PieceType{
 	PT_LSHIFT = '<'
 };
 
-// most basic unit of information for processing
-// can represent a symbol or value (strings and numbers)
-struct Piece{
-	union{	// each piece uses only one of the union members
-		size_t stridx;		// index of string start in array of characters (usually from global stringCharsList)
-		int32_t integer;	// integer value
-	};
-	enum PieceType type;		// type of the piece
-};
-
 // holds data about any label, which is a string associated with value and represents locations in code or constants
 struct Label{
 	int32_t value;		// integer value of the label, can represent constants or offsets or other
-	// can this be the enum and not uint8?
+	uint32_t name;		// string id of the identifier
 	uint8_t type;		// type of the label (defined, undefined, etc.)
-	size_t name;		// index of identifier string start in array of characters
 };
 
 // information on all parts of 1 complete instruction
 // all member sizes are accurate to what is on the 6502
 struct Instruction{
-	uint8_t size;		// byte length of ins
-	uint8_t opcode;		// opcode value
 	int32_t value;		// value of ins expression
+	uint32_t expr;		// handle of the compiled expression, EXPR_NONE if the value is known, the value is then placed by a struct Reloc
 	uint16_t offset;	// byte offset from beggining of instructions
-	size_t expr;		// index of start of expression for evaluation
+	uint8_t size;		// byte length of ins
+	uint8_t opcode;		// opcode value
+	uint8_t mode;		// addressing mode (enum AddressingMode)
+};
+
+// how a relocation places its value
+enum RelocKind{
+	RK_WORD,	// 16-bit value
+	RK_ZERO_PAGE,	// 8-bit address, must be in zero page
+	RK_IMMEDIATE,	// low byte of the value
+	RK_BRANCH,	// 8-bit signed distance from the end of the branch instruction to the value
+	RK_ADDRESS,	// 16-bit address of an instruction that also has a zero page form
+	RK_SHRUNK,	// 8-bit address of an RK_ADDRESS instruction shrunk to zero page, widened again if its value leaves it
+};
+
+// value of an instruction that was not known while scanning, patched into the image by fixupInstructions
+struct Reloc{
+	uint32_t expr;		// handle of the compiled expression of the value
+	uint16_t offset;	// address of the first byte of the value in the image
+	uint8_t kind;		// enum RelocKind
+};
+
+// one step of a compiled expression, the operand is applied to the running result with op
+struct ExprOp{
+	uint8_t op;		// PT_ADD, PT_SUB, PT_RSHIFT or PT_LSHIFT
+	bool label;		// operand is the value of a label instead of an integer
+	union{
+		int32_t integer;	// integer operand
+		uint32_t name;		// string id of the label operand
+	};
+};
+
+// compiled expression, its steps are in the code list of the file it was compiled in
+struct Expr{
+	uint32_t code;		// index of the first step in the code list
+	uint32_t len;		// number of steps
+	uint32_t piece;		// index of the first source piece, for error messages
 };
 
 // change name maybe...
@@ -69,6 +107,8 @@ enum CID{
 	CID_SET,	// set a memory location to have a value, evaluated after all instructions placed and after all other commands
 	CID_LABEL,
 	CID_STRING,
+	CID_SEGMENT,	// choose the segment the file is placed in or allocates from
+	CID_CYCLES,	// limit the worst case cycles between two addresses, checked once the image is finished
 	CID_NULL	// none
 };
 
@@ -76,43 +116,53 @@ enum CID{
 // union holds structures for each command for indeterminate values
 // used when a command cant be evaluated at first and needs to be done later
 struct Command{
-	enum CID id; // identifies what structure is in the union
+	uint8_t id; // enum CID, identifies what structure is in the union
 	union{
 		struct{ // drop command
 			uint16_t offset;	// address offset to place the value
-			size_t expr;		// index into pieceList for start of expression for the value
+			uint32_t expr;		// handle of the expression for the value
 		} drop;
 		
 		struct{ // drop16 command
 			uint16_t offset;	// address offset to place the value
-			size_t expr;		// index into pieceList for start of expression for the value
+			uint32_t expr;		// handle of the expression for the value
 		} drop16;
 
 		struct{ // constant command
-			size_t name;		// index into characterStringList for name of constant label
-			size_t expr;		// index into pieceList for start of expression for value
+			uint32_t name;		// index into characterStringList for name of constant label
+			uint32_t expr;		// handle of the expression for the value
 		} constant;
 		
 		struct{ // allocate command
-			size_t name;		// index into characterStringList for name of allocated label
-			size_t expr;		// index into pieceList for start of expression for value
+			uint32_t name;		// index into characterStringList for name of allocated label
+			uint32_t expr;		// handle of the expression for the value
 		} alloc;
 
 		struct{ // set command
-			size_t addr;		// index into pieceList for expression of address
-			size_t value;		// same but expression of value
+			uint32_t addr;		// handle of the expression for the address
+			uint32_t value;		// same but expression of value
 		} set;
 
 		struct{ // label command
-			size_t addr;
-			size_t name;
+			uint32_t addr;
+			uint32_t name;
 		} label;
 
 		struct{
-			size_t name;
-			size_t value;
-			size_t offset;
+			uint32_t name;
+			uint32_t value;
+			uint32_t offset;
 		} string;
+
+		struct{ // segment command
+			uint32_t name;		// string id of the segment name
+		} segment;
+
+		struct{ // cycles command
+			uint32_t from;		// handle of the expression for the address paths start at
+			uint32_t to;		// same but for the address paths end at
+			uint32_t max;		// same but for the most cycles a path can take
+		} cycles;
 	};
 };
 
@@ -3,17 +3,48 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "types.h"
 #include "list.h"
 
 // macro function for testing if a piece type counts as the end of an expression
 #define IS_EXPR_END(t) ((t) == PT_LINE || (t) == PT_EXPR_DELIM)
 
+// pieces are referred to by their index in the piece stream of their file
+
+// type of piece p in file f
+static inline enum PieceType pieceType(const struct FileData* f, size_t p){
+	return LIST_BEG(&f->pieces.types, uint8_t)[p];
+}
+
+// string id of the PT_STRING piece p in file f
+static inline uint32_t pieceString(const struct FileData* f, size_t p){
+	return LIST_BEG(&f->pieces.values, uint32_t)[p];
+}
+
+// value of the PT_INTEGER piece p in file f
+static inline int32_t pieceInteger(const struct FileData* f, size_t p){
+	return (int32_t)LIST_BEG(&f->pieces.values, uint32_t)[p];
+}
+
+// add a piece to the end of the stream of file f, value is ignored for symbol pieces
+void addPiece(struct FileData* f, enum PieceType type, uint32_t value);
+
 extern struct FileData* filesArray;
 struct FileData newFileData(const char* name);
 
-extern unsigned char* memImage;
-extern size_t memIdx;
+// allocate the lists of f from its arena, reserving space estimated from the byte size of its source
+void fileDataUseArena(struct FileData* f, size_t sourceSize);
+
+// release all memory of f at once
+void fileDataZero(struct FileData* f);
+
+#define ADDRESS_SPACE 0x10000 // bytes the cpu addresses, the image holds one for each address
+
+// each thread has its own image and index so files can be scanned in parallel
+// the image is indexed by address, the output is made of the rom segments of it, see memmap.h
+extern _Thread_local unsigned char* memImage;
+extern _Thread_local size_t memIdx;
 
 //extern struct List stringCharsList;
 
@@ -29,15 +60,8 @@ extern size_t memIdx;
  * works for base 2, 8, 10, and 16 with, respectively, 0BN, 0N, N, and 0XN where N is the number in each base ("0B" and "0X" return 0)
  */
 extern int fssize;
-bool evalExpression(struct Piece p[], int* res);
-
-/*
- * evaluate the expression from pieces from array p and store the result in *res
- * returns false on failure/true on success
- * failure can result from presently undefined values and is not always arithmetic related
- */
 
-int exprArrayLen(const struct Piece p[]);
+int exprArrayLen(const struct FileData* f, size_t p);
 
 /*
  * return the total number of pieces in an expression from p
@@ -46,20 +70,20 @@ int exprArrayLen(const struct Piece p[]);
  * the function will not return 0; overflow resulting in a would be 0 return value gives 1
  */
 
-char* printExpr(struct Piece p[]);
+char* printExpr(const struct FileData* f, size_t p);
 
 /*
- * returns a string for the expression from array p
+ * returns a string for the expression starting at piece p of file f
  * the returned array is statically allocated within the function
  * different formatting for different piece types
  * the returned string is nul-terminated
  */
 
-bool commandHandler(struct Piece in[], struct FileData* f);
+bool commandHandler(size_t in, struct FileData* f);
 
 /*
  * NOT defined in utility.c
- * processes a command from a line of input from array in
+ * processes a command from a line of input starting at piece in of file f
  * returns true on success; false on failure
  */
 
@@ -67,7 +91,8 @@ bool commandHandler(struct Piece in[], struct FileData* f);
 void createPieces(struct FileData* f);
 
 /*
- * opens a file with filename, reads all of the contents and creates pieces, then closes the file
+ * maps the file with filename read only, creates pieces from all of the contents, then unmaps and closes the file
+ * tokens are upper cased while being classified, the file contents are never modified
  * uses the global pieceList object to store generated pieces in
  * also adds characters to the global stringCharsList object for some pieces
  * does not delete contents in these lists on each call; subsequent calls add to the end
@@ -85,12 +110,12 @@ int scanPieces(struct FileData* f);
  * the line number starts at 1 and is updated after an amount of pieces processed represents a line
  */
 
-struct Piece* getInsLine(struct Piece p[], struct Instruction* out, struct FileData* f);
+size_t getInsLine(size_t p, struct Instruction* out, struct FileData* f);
 
 /*
- * forms an instruction from an instruction line from array p and stores resulting instruction in *out
- * returns the last piece that was processed which is the piece for the EOL
- * returns NULL on failure
+ * forms an instruction from an instruction line starting at piece p of file f and stores resulting instruction in *out
+ * returns the index of the last piece that was processed which is the piece for the EOL
+ * returns 0 on failure, the EOL piece always comes after the instruction name so it is never piece 0
  */
 
 #endif
@@ -0,0 +1,10 @@
+// assembler that stays resident and rebuilds the image when input files change
+
+#ifndef WATCH_H
+#define WATCH_H
+
+// scan every file in filesArray using up to jobs threads, write the image to outputName, then rebuild it each time inputs are saved
+// only the files that changed are lexed and scanned again, a file with errors fails the builds until it is fixed, never returns
+void watchFiles(int jobs, const char* outputName) __attribute__((noreturn));
+
+#endif
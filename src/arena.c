@@ -0,0 +1,77 @@
+#include "arena.h"
+#include "error.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+
+struct ArenaBlock{
+	struct ArenaBlock* next;	// older block
+	size_t size;			// byte size of data
+	size_t used;			// bytes of data allocated
+	size_t last;			// offset of the newest allocation, which can grow in place
+	max_align_t data[];
+};
+
+struct Arena globalArena = {.blockSize = 1 << 16};
+
+// round size up to the alignment of every allocation
+static size_t alignSize(size_t size){
+	return (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+// add a block with at least size bytes free to the front of arena a
+static void addBlock(struct Arena* a, size_t size){
+	size = size > a->blockSize ? size : a->blockSize;
+	struct ArenaBlock* b = malloc(sizeof(struct ArenaBlock) + size);
+	testError(!b, "arena block alloc fail (%zu bytes)", size);
+	b->next = a->blocks;
+	b->size = size;
+	b->used = 0;
+	b->last = 0;
+	a->blocks = b;
+}
+
+struct Arena newArena(size_t blockSize){
+	struct Arena a = {.blocks = NULL, .blockSize = blockSize};
+	return a;
+}
+
+void* arenaAlloc(struct Arena* a, size_t size){
+	size = alignSize(size);
+	if(!a->blocks || a->blocks->size - a->blocks->used < size){
+		addBlock(a, size);
+	}
+	struct ArenaBlock* b = a->blocks;
+	b->last = b->used;
+	b->used += size;
+	return (unsigned char*)b->data + b->last;
+}
+
+void* arenaGrow(struct Arena* a, void* p, size_t oldSize, size_t newSize){
+	if(!p){
+		return arenaAlloc(a, newSize);
+	}
+	struct ArenaBlock* b = a->blocks;
+	if(p == (unsigned char*)b->data + b->last && b->size - b->last >= alignSize(newSize)){
+		b->used = b->last + alignSize(newSize);
+		return p;
+	}
+	void* q = arenaAlloc(a, newSize);
+	memcpy(q, p, oldSize < newSize ? oldSize : newSize);
+	return q;
+}
+
+void arenaReserve(struct Arena* a, size_t size){
+	size = alignSize(size);
+	if(!a->blocks || a->blocks->size - a->blocks->used < size){
+		addBlock(a, size);
+	}
+}
+
+void arenaZero(struct Arena* a){
+	while(a->blocks){
+		struct ArenaBlock* b = a->blocks;
+		a->blocks = b->next;
+		free(b);
+	}
+}
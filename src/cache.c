@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "object.h"
+#include "error.h"
+#include "utility.h"
+#include "stats.h"
+
+const char* cacheDir = NULL;
+
+// FNV-1a over len bytes from p continuing from h
+static uint64_t hashBytes(uint64_t h, const void* p, size_t len){
+	const unsigned char* c = p;
+	for(size_t a = 0; a < len; ++a){
+		h ^= c[a];
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+uint64_t cacheKey(const char* name){
+	int fd = open(name, O_RDONLY);
+	testError(fd < 0, "error opening file \"%s\": %s", name, strerror(errno));
+	struct stat st;
+	testError(fstat(fd, &st), "error reading file \"%s\": %s", name, strerror(errno));
+	uint64_t h = 0xCBF29CE484222325ULL;
+	if(st.st_size){
+		const char* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		testError(data == MAP_FAILED, "error mapping file \"%s\": %s", name, strerror(errno));
+		h = hashBytes(h, data, st.st_size);
+		munmap((void*)data, st.st_size);
+	}
+	close(fd);
+	static const char version[] = MBASM_VERSION;
+	return hashBytes(h, version, sizeof(version));
+}
+
+// write the name of the entry for key into buf
+static void entryName(char* buf, size_t size, uint64_t key){
+	snprintf(buf, size, "%s/%.16llx.ir", cacheDir, (unsigned long long)key);
+}
+
+bool cacheLoad(struct FileData* f, uint64_t key){
+	char name[4096];
+	entryName(name, sizeof(name), key);
+	size_t size;
+	if(!readScan(name, SCAN_CACHE, key, f, memImage, &size, NULL)){
+		STAT_ADD(cacheMisses, 1);
+		return false;
+	}
+	memIdx = size;
+	STAT_ADD(cacheHits, 1);
+	return true;
+}
+
+void cacheStore(const struct FileData* f, uint64_t key, const struct StringTable* strings){
+	char name[4096];
+	entryName(name, sizeof(name), key);
+	writeScan(name, SCAN_CACHE, key, f, strings, memImage, memIdx);
+}
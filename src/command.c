@@ -8,8 +8,10 @@
 #include "utility.h"
 #include "error.h"
 #include "stringmanip.h"
+#include "expr.h"
+#include "memmap.h"
 
-static struct FileData* currf;
+static _Thread_local struct FileData* currf;
 static const char* formats[] = {
 	[CID_LABEL] = ".LABEL STRING:LABEL NAME",
 	[CID_CONST] = ".CONST STIRNG:CONSTANT NAME, EXPR:CONSTANT VALUE",
@@ -18,20 +20,22 @@ static const char* formats[] = {
 	[CID_STRING] = ".STRING STRING:STRING NAME, STRING:CONTENTS",
 	[CID_SET] = ".SET EXPR:ADDRESS, EXPR:VALUE",
 	[CID_DROP16] = ".DROP16 EXPR:DROP VALUE",
+	[CID_SEGMENT] = ".SEGMENT STRING:SEGMENT NAME",
+	[CID_CYCLES] = ".CYCLES EXPR:FROM ADDRESS, EXPR:TO ADDRESS, EXPR:MOST CYCLES",
 };
 
 // these static functions check the formatting and create a command structure
 
 // for LABEL command, creates an undefined label with name and relative location
-static struct Command comLabel(struct Piece in[]){
+static struct Command comLabel(size_t in){
 	struct Command c = {.id = CID_NULL};
 
-	if(exprArrayLen(in) != -2){
+	if(exprArrayLen(currf, in) != -2){
 		addErrorMessage(formats[CID_LABEL]);
 		addErrorMessage("first/final argument given incorrectly");
 		return c;
 	}
-	if(in[0].type != PT_STRING){
+	if(pieceType(currf, in) != PT_STRING){
 		addErrorMessage(formats[CID_LABEL]);
 		addErrorMessage("string expeceted for label name");
 		return c;
@@ -39,156 +43,245 @@ static struct Command comLabel(struct Piece in[]){
 
 	c.id = CID_LABEL;
 	c.label.addr = memIdx;
-	c.label.name = in[0].stridx;
+	c.label.name = pieceString(currf, in);
 	return c;
 }
 
 // for CONST command, creates a defined label with name and value
-static struct Command comConst(struct Piece in[]){
+static struct Command comConst(size_t in){
 	struct Command c = {.id = CID_NULL};
 
-	struct Piece* p = in;
-	if(exprArrayLen(p) != 2){
+	size_t p = in;
+	if(exprArrayLen(currf, p) != 2){
 		addErrorMessage(formats[CID_CONST]);
 		addErrorMessage("first argument given incorrectly");
 		return c;
 	}
-	if(p[0].type != PT_STRING){
+	if(pieceType(currf, p) != PT_STRING){
 		addErrorMessage("string expeceted for constant name");
 		return c;
 	}
 	p += 2;
-	if(exprArrayLen(p) > -2){
+	if(exprArrayLen(currf, p) > -2){
 		addErrorMessage(formats[CID_CONST]);
 		addErrorMessage("second/final argument given incorrectly");
 		return c;
 	}
 
+	if((c.constant.expr = compileExpression(p, currf)) == EXPR_NONE){
+		return c;
+	}
 	c.id = CID_CONST;
-	c.constant.name = in[0].stridx;
-	c.constant.expr = p - (struct Piece*)currf->pieces.data;
+	c.constant.name = pieceString(currf, in);
 	return c;
 }
 
 // for DROP16 command, place a byte value at current relative position in memory
-static struct Command comDrop16(struct Piece in[]){
+static struct Command comDrop16(size_t in){
 	struct Command c = {.id = CID_NULL};
 
-	if(exprArrayLen(in) > -2){
+	if(exprArrayLen(currf, in) > -2){
 		addErrorMessage(formats[CID_DROP16]);
 		addErrorMessage("first/final argument given incorrectly");
 		return c;
 	}
+	if((c.drop16.expr = compileExpression(in, currf)) == EXPR_NONE){
+		return c;
+	}
 	c.id = CID_DROP16;
-	c.drop16.expr = in - (struct Piece*)currf->pieces.data;
 	c.drop16.offset = memIdx;
 	memIdx += 2;
 	return c;
 }
 
 // for DROP command, place a byte value at current relative position in memory
-static struct Command comDrop(struct Piece in[]){
+static struct Command comDrop(size_t in){
 	struct Command c = {.id = CID_NULL};
 
-	if(exprArrayLen(in) > -2){
+	if(exprArrayLen(currf, in) > -2){
 		addErrorMessage(formats[CID_DROP]);
 		addErrorMessage("first/final argument given incorrectly");
 		return c;
 	}
+	if((c.drop.expr = compileExpression(in, currf)) == EXPR_NONE){
+		return c;
+	}
 	c.id = CID_DROP;
-	c.drop.expr = in - (struct Piece*)currf->pieces.data;
 	c.drop.offset = memIdx++;
 	return c;
 }
 
 // for ALLOC command, label takes the value of an incremental address given by assembler from a name and byte length
-static struct Command comAlloc(struct Piece in[]){
+static struct Command comAlloc(size_t in){
 	struct Command c = {.id = CID_NULL};
 
-	struct Piece* p = in;
-	if(exprArrayLen(p) != 2){
+	size_t p = in;
+	if(exprArrayLen(currf, p) != 2){
 		addErrorMessage(formats[CID_ALLOC]);
 		addErrorMessage("first argument given incorrectly");
 		return c;
 	}
-	if(p[0].type != PT_STRING){
+	if(pieceType(currf, p) != PT_STRING){
 		addErrorMessage("string expeceted for alloc name");
 		return c;
 	}
 	p += 2;
-	if(exprArrayLen(p) > -2){
+	if(exprArrayLen(currf, p) > -2){
 		addErrorMessage(formats[CID_ALLOC]);
 		addErrorMessage("second/final argument given incorrectly");
 		return c;
 	}
 
+	if((c.alloc.expr = compileExpression(p, currf)) == EXPR_NONE){
+		return c;
+	}
 	c.id = CID_ALLOC;
-	c.alloc.name = in[0].stridx;
-	c.alloc.expr = p - (struct Piece*)currf->pieces.data;
+	c.alloc.name = pieceString(currf, in);
 	return c;
 }
 
 // for STRING command, place ascii string of characters in memory at current relative position ending with nul char and create label with name
-static struct Command comString(struct Piece in[]){
+static struct Command comString(size_t in){
 	struct Command c = {.id = CID_NULL};
 
-	struct Piece* p = in;
-	if(exprArrayLen(p) != 2){
+	size_t p = in;
+	if(exprArrayLen(currf, p) != 2){
 		addErrorMessage(formats[CID_STRING]);
 		addErrorMessage("first argument given incorrectly");
 		return c;
 	}
-	if(p[0].type != PT_STRING){
+	if(pieceType(currf, p) != PT_STRING){
 		addErrorMessage("string expeceted for string name");
 		return c;
 	}
 	p += 2;
-	if(exprArrayLen(p) != -2){
+	if(exprArrayLen(currf, p) != -2){
 		addErrorMessage(formats[CID_STRING]);
 		addErrorMessage("second/final argument given incorrectly");
 		return c;
 	}
-	if(p[0].type != PT_STRING){
+	if(pieceType(currf, p) != PT_STRING){
 		addErrorMessage("string expeceted for string value");
 		return c;
 	}
 
 	c.id = CID_STRING;
-	c.string.name = in[0].stridx;
-	c.string.value = p[0].stridx;
+	c.string.name = pieceString(currf, in);
+	c.string.value = pieceString(currf, p);
 	c.string.offset = memIdx;
 	memIdx += strlen(stringAt(c.string.value)) + 1;
 	return c;
 }
 
 // for SET command, set byte value at certain address from given value
-static struct Command comSet(struct Piece in[]){
+static struct Command comSet(size_t in){
 	struct Command c = {.id = CID_NULL};
 
-	struct Piece* p = in;
-	if(exprArrayLen(p) < 2){
+	size_t p = in;
+	if(exprArrayLen(currf, p) < 2){
 		addErrorMessage(formats[CID_SET]);
 		addErrorMessage("first argument given incorrectly");
 		return c;
 	}
-	p += exprArrayLen(p);
-	if(exprArrayLen(p) > -2){
+	p += exprArrayLen(currf, p);
+	if(exprArrayLen(currf, p) > -2){
 		addErrorMessage(formats[CID_SET]);
 		addErrorMessage("second/final argument given incorrectly");
 		return c;
 	}
 
+	if((c.set.addr = compileExpression(in, currf)) == EXPR_NONE || (c.set.value = compileExpression(p, currf)) == EXPR_NONE){
+		return c;
+	}
 	c.id = CID_SET;
-	c.set.addr = in - (struct Piece*)currf->pieces.data;
-	c.set.value = p - (struct Piece*)currf->pieces.data;
 	return c;
 }
 
+// for CYCLES command, fail the build if a path from one address to another can take more cycles than given
+// a path ends when it reaches the to address or leaves the code, so a loop is checked with its label as both addresses
+static struct Command comCycles(size_t in){
+	struct Command c = {.id = CID_NULL};
 
+	size_t p = in, p2;
+	if(exprArrayLen(currf, p) < 2){
+		addErrorMessage(formats[CID_CYCLES]);
+		addErrorMessage("first argument given incorrectly");
+		return c;
+	}
+	p += exprArrayLen(currf, p);
+	if(exprArrayLen(currf, p) < 2){
+		addErrorMessage(formats[CID_CYCLES]);
+		addErrorMessage("second argument given incorrectly");
+		return c;
+	}
+	p2 = p + exprArrayLen(currf, p);
+	if(exprArrayLen(currf, p2) > -2){
+		addErrorMessage(formats[CID_CYCLES]);
+		addErrorMessage("third/final argument given incorrectly");
+		return c;
+	}
+
+	if((c.cycles.from = compileExpression(in, currf)) == EXPR_NONE || (c.cycles.to = compileExpression(p, currf)) == EXPR_NONE || (c.cycles.max = compileExpression(p2, currf)) == EXPR_NONE){
+		return c;
+	}
+	c.id = CID_CYCLES;
+	return c;
+}
+
+// for SEGMENT command, place the file in a rom segment or take its allocations from a ram segment of the memory map
+// a rom segment must be chosen before the file places anything, everything in a file is in one segment
+static struct Command comSegment(size_t in){
+	struct Command c = {.id = CID_NULL};
+
+	if(exprArrayLen(currf, in) != -2){
+		addErrorMessage(formats[CID_SEGMENT]);
+		addErrorMessage("first/final argument given incorrectly");
+		return c;
+	}
+	if(pieceType(currf, in) != PT_STRING){
+		addErrorMessage(formats[CID_SEGMENT]);
+		addErrorMessage("string expected for segment name");
+		return c;
+	}
+	char* name = stringAt(pieceString(currf, in));
+	int seg = findSegment(name);
+	if(seg < 0){
+		addErrorMessage("segment \"%s\" is not in the memory map", name);
+		return c;
+	}
+
+	if(LIST_AT(&segments, struct Segment, seg)->rom){
+		if(currf->romSegment >= 0){
+			addErrorMessage("file is already placed in segment \"%s\"", LIST_AT(&segments, struct Segment, currf->romSegment)->name);
+			return c;
+		}
+		// labels and bytes before it would have addresses in the default segment
+		bool placed = currf->instructions.elementCount;
+		for(struct Command* p = listBeg(&currf->commands); p != listEnd(&currf->commands); ++p){
+			placed |= p->id == CID_LABEL || p->id == CID_DROP || p->id == CID_DROP16 || p->id == CID_STRING;
+		}
+		if(placed){
+			addErrorMessage("a rom segment must be chosen before any instruction, label or data of the file");
+			return c;
+		}
+		currf->romSegment = seg;
+		placeInSegment(seg);
+	}else{
+		if(currf->ramSegment >= 0){
+			addErrorMessage("file already allocates from segment \"%s\"", LIST_AT(&segments, struct Segment, currf->ramSegment)->name);
+			return c;
+		}
+		currf->ramSegment = seg;
+	}
+	c.id = CID_SEGMENT;
+	c.segment.name = pieceString(currf, in);
+	return c;
+}
 
 // takes in pieces from a command line and chooses what function to call
-bool commandHandler(struct Piece in[], struct FileData* f){
-	if(in[0].type != PT_STRING){
+bool commandHandler(size_t in, struct FileData* f){
+	currf = f;
+	if(pieceType(currf, in) != PT_STRING){
 		addErrorMessage("string expected for command name");
 		return false;
 	}
@@ -196,7 +289,7 @@ bool commandHandler(struct Piece in[], struct FileData* f){
 	// string literal used to call command and function pointer to it
 	struct{
 		const char* name;
-		struct Command (*func)(struct Piece[]);
+		struct Command (*func)(size_t);
 	} commandArray[] = {
 		{"LABEL", comLabel},
 		{"L", comLabel},
@@ -207,11 +300,12 @@ bool commandHandler(struct Piece in[], struct FileData* f){
 		{"DROP16", comDrop16},
 		{"ALLOC", comAlloc},
 		{"SET", comSet},
+		{"SEGMENT", comSegment},
+		{"CYCLES", comCycles},
 	};
-	currf = f;
 	// attempt to find a matching command name and call command function
 	for(int a = 0; a < sizeof(commandArray) / sizeof(commandArray[0]); ++a){
-		if(!strcmp(commandArray[a].name, stringAt(in[0].stridx))){
+		if(!strcmp(commandArray[a].name, stringAt(pieceString(currf, in)))){
 			struct Command res = commandArray[a].func(in + 1);
 			if(res.id == CID_NULL){
 				addErrorMessage("error processing command \"%s\"", commandArray[a].name);
@@ -221,6 +315,6 @@ bool commandHandler(struct Piece in[], struct FileData* f){
 			return true;
 		}
 	}
-	addErrorMessage("command name \"%s\" not recognized", stringAt(in[0].stridx));
+	addErrorMessage("command name \"%s\" not recognized", stringAt(pieceString(currf, in)));
 	return false;
 }
@@ -4,9 +4,15 @@
 #include "stringmanip.h"
 #include "types.h"
 #include "commandeval.h"
+#include "symbols.h"
+#include "expr.h"
 #include <string.h>
+#include "error.h"
+#include "trace.h"
+#include "stats.h"
 
-extern struct List setCommands;
+struct List setCommands = {.allocStep = 50, .elementSize = sizeof(int) * 2};
+struct List cycleChecks = {.allocStep = 16, .elementSize = sizeof(struct CycleCheck)};
 
 static int nulleval(struct FileData*, struct Command*){
 	return 0;
@@ -14,7 +20,7 @@ static int nulleval(struct FileData*, struct Command*){
 
 static int dropeval(struct FileData* f, struct Command* c){
 	static int v;
-	if(evalExpression(listAt(f->pieces, c->drop.expr), &v)){
+	if(evalExpression(f, c->drop.expr, &v)){
 		memImage[c->drop.offset] = v;
 		c->id = CID_NULL;
 		return 1;
@@ -24,7 +30,7 @@ static int dropeval(struct FileData* f, struct Command* c){
 
 static int drop16eval(struct FileData* f, struct Command* c){
 	static int v;
-	if(evalExpression(listAt(f->pieces, c->drop16.expr), &v)){
+	if(evalExpression(f, c->drop16.expr, &v)){
 		memImage[c->drop16.offset] = v;
 		memImage[c->drop16.offset + 1] = v >> 8;
 		c->id = CID_NULL;
@@ -35,9 +41,9 @@ static int drop16eval(struct FileData* f, struct Command* c){
 
 static int consteval(struct FileData* f, struct Command* c){
 	static int v;
-	if(evalExpression(listAt(f->pieces, c->constant.expr), &v)){
+	if(evalExpression(f, c->constant.expr, &v)){
 		struct Label l = {.value = v, .type = LT_DEFINED, .name = c->constant.name};
-		listAdd(&f->labels, &l, 1);
+		addLabel(f, l);
 		c->id = CID_NULL;
 		return 1;
 	}
@@ -46,9 +52,9 @@ static int consteval(struct FileData* f, struct Command* c){
 
 static int alloceval(struct FileData* f, struct Command* c){
 	static int v;
-	if(evalExpression(listAt(f->pieces, c->alloc.expr), &v)){
+	if(evalExpression(f, c->alloc.expr, &v)){
 		struct Label l = {.value = v, .type = LT_ALLOC, .name = c->alloc.name};
-		listAdd(&f->labels, &l, 1);
+		addLabel(f, l);
 		c->id = CID_NULL;
 		return 1;
 	}
@@ -56,16 +62,16 @@ static int alloceval(struct FileData* f, struct Command* c){
 }
 
 static int labeleval(struct FileData* f, struct Command* c){
-	struct Label l = {.value = c->label.addr + 0x8000, .type = LT_DEFINED, .name = c->label.name};
-	listAdd(&f->labels, &l, 1);
+	struct Label l = {.value = c->label.addr, .type = LT_DEFINED, .name = c->label.name};
+	addLabel(f, l);
 	c->id = CID_NULL;
 	return 1;
 }
 
 static int seteval(struct FileData* f, struct Command* c){
 	static int v, v2;
-	if(evalExpression(listAt(f->pieces, c->set.addr), &v)){
-		if(evalExpression(listAt(f->pieces, c->set.value), &v2)){
+	if(evalExpression(f, c->set.addr, &v)){
+		if(evalExpression(f, c->set.value, &v2)){
 			listAdd(&setCommands, &(int[2]){v, v2}, 1);
 			c->id = CID_NULL;
 			return 1;
@@ -75,8 +81,8 @@ static int seteval(struct FileData* f, struct Command* c){
 }
 
 static int stringeval(struct FileData* f, struct Command* c){
-	struct Label l = {.value = c->string.offset + 0x8000, .type = LT_DEFINED, .name = c->string.name};
-	listAdd(&f->labels, &l, 1);
+	struct Label l = {.value = c->string.offset, .type = LT_DEFINED, .name = c->string.name};
+	addLabel(f, l);
 	for(int idx = 0; idx <= strlen(stringAt(c->string.value)); ++idx){
 		memImage[c->string.offset + idx] = stringAt(c->string.value)[idx];
 	}
@@ -84,21 +90,221 @@ static int stringeval(struct FileData* f, struct Command* c){
 	return 1;
 }
 
-int commandEval(struct FileData* f){
-	static int (*evallist[])(struct FileData*, struct Command*) = {
-		[CID_NULL] = nulleval,
-		[CID_DROP] = dropeval,
-		[CID_DROP16] = drop16eval,
-		[CID_CONST] = consteval,
-		[CID_ALLOC] = alloceval,
-		[CID_STRING] = stringeval,
-		[CID_LABEL] = labeleval,
-		[CID_SET] = seteval
-	};
-	int ct = 0;
-	for(int a = 0; a < f->commands.elementCount; ++a){
-		struct Command* c = (struct Command*)f->commands.data + a;
-		ct += evallist[c->id](f, c);
-	}
-	return ct;
+static int cycleseval(struct FileData* f, struct Command* c){
+	static int from, to, max;
+	if(evalExpression(f, c->cycles.from, &from) && evalExpression(f, c->cycles.to, &to) && evalExpression(f, c->cycles.max, &max)){
+		struct CycleCheck check = {.file = f - filesArray, .from = c->cycles.from, .to = c->cycles.to, .fromAddr = from, .toAddr = to, .max = max};
+		listAdd(&cycleChecks, &check, 1);
+		c->id = CID_NULL;
+		return 1;
+	}
+	return 0;
+}
+
+// segments are assigned when the file is placed, see assignSegments
+static int segmenteval(struct FileData*, struct Command* c){
+	c->id = CID_NULL;
+	return 1;
+}
+
+static int (*evallist[])(struct FileData*, struct Command*) = {
+	[CID_NULL] = nulleval,
+	[CID_DROP] = dropeval,
+	[CID_DROP16] = drop16eval,
+	[CID_CONST] = consteval,
+	[CID_ALLOC] = alloceval,
+	[CID_STRING] = stringeval,
+	[CID_LABEL] = labeleval,
+	[CID_SET] = seteval,
+	[CID_SEGMENT] = segmenteval,
+	[CID_CYCLES] = cycleseval
+};
+
+// a command that could not be evaluated yet and the label it is waiting for
+struct Pending{
+	struct FileData* file;
+	size_t cmd;	// index into the commands list of file
+	size_t label;	// string id of the undefined label the last evaluation stopped at
+	size_t next;	// index + 1 of the next pending command waiting on the same label, 0 ends the chain
+};
+
+static struct List pendingList = {.allocStep = 50, .elementSize = sizeof(struct Pending)};
+static struct List waitHeads = {.allocStep = 100, .elementSize = sizeof(size_t)}; // per string id, index + 1 of the first pending command waiting on it
+static struct List workList = {.allocStep = 50, .elementSize = sizeof(size_t)}; // indexes of pending commands whose label was defined
+
+// return the string id of the label a command defines with LT_DEFINED, SIZE_MAX if it defines none
+static size_t definedName(const struct Command* c){
+	switch(c->id){
+		case CID_CONST:
+			return c->constant.name;
+		case CID_LABEL:
+			return c->label.name;
+		case CID_STRING:
+			return c->string.name;
+		default:
+			return SIZE_MAX;
+	}
+}
+
+// return the string id of the label a command creates of any type, SIZE_MAX if it creates none
+static size_t createdName(const struct Command* c){
+	return c->id == CID_ALLOC ? c->alloc.name : definedName(c);
+}
+
+// attempt command cmd from file f, pidx is the index of its pending entry or SIZE_MAX if it has none
+// on success commands waiting on the label it defines are moved to the work list
+// on failure the command waits on the label that stopped it, expressions are compiled so nothing else can stop it
+static void tryCommand(struct FileData* f, size_t cmd, size_t pidx){
+	struct Command* c = listAt(&f->commands, cmd);
+	size_t name = definedName(c);
+	STAT_ADD(commandAttempts, 1);
+	if(evallist[c->id](f, c)){
+		if(pidx == SIZE_MAX){
+			STAT_ADD(commandsFirst, 1);
+		}else{
+			STAT_ADD(commandsRetried, 1);
+		}
+		if(name < waitHeads.elementCount){
+			size_t* head = listAt(&waitHeads, name);
+			for(size_t w = *head; w;){
+				size_t wake = w - 1;
+				listAdd(&workList, &wake, 1);
+				w = LIST_AT(&pendingList, struct Pending, wake)->next;
+			}
+			*head = 0;
+		}
+		return;
+	}
+	clearErrors();
+	if(pidx == SIZE_MAX){
+		struct Pending p = {.file = f, .cmd = cmd};
+		listAdd(&pendingList, &p, 1);
+		pidx = pendingList.elementCount - 1;
+	}
+	static const size_t none = 0;
+	while(waitHeads.elementCount <= missingLabel){
+		listAdd(&waitHeads, &none, 1);
+	}
+	struct Pending* p = listAt(&pendingList, pidx);
+	size_t* head = listAt(&waitHeads, missingLabel);
+	p->label = missingLabel;
+	p->next = *head;
+	*head = pidx + 1;
+}
+
+// return the expression of command c to show in error messages
+static size_t commandExpr(struct FileData* f, struct Command* c){
+	switch(c->id){
+		case CID_DROP:
+			return exprPieces(f, c->drop.expr);
+		case CID_DROP16:
+			return exprPieces(f, c->drop16.expr);
+		case CID_CONST:
+			return exprPieces(f, c->constant.expr);
+		case CID_ALLOC:
+			return exprPieces(f, c->alloc.expr);
+		case CID_CYCLES:
+			;
+			// show whichever cycles expression fails
+			int from, to;
+			bool fromOk = evalExpression(f, c->cycles.from, &from);
+			bool toOk = fromOk && evalExpression(f, c->cycles.to, &to);
+			clearErrors();
+			return exprPieces(f, !fromOk ? c->cycles.from : !toOk ? c->cycles.to : c->cycles.max);
+		default:
+			;
+			// show whichever set expression fails
+			int v;
+			bool addrOk = evalExpression(f, c->set.addr, &v);
+			clearErrors();
+			return exprPieces(f, addrOk ? c->set.value : c->set.addr);
+	}
+}
+
+// add error messages for the first unresolved command, following the labels it waits on to a cycle or undefined label
+static void reportUnresolved(void){
+	struct Pending* p = listBeg(&pendingList);
+	while(LIST_AT(&p->file->commands, struct Command, p->cmd)->id == CID_NULL){
+		++p;
+	}
+	struct FileData* f = p->file;
+	struct Command* c = listAt(&f->commands, p->cmd);
+
+	struct List chain = listNew(sizeof(size_t), 10);
+	while(true){
+		// a repeated label closes a cycle
+		for(size_t* n = listBeg(&chain); n != listEnd(&chain); ++n){
+			if(*n == p->label){
+				struct List msg = listNew(1, 100);
+				for(; n != listEnd(&chain); ++n){
+					listAdd(&msg, stringAt(*n), strlen(stringAt(*n)));
+					listAdd(&msg, " -> ", 4);
+				}
+				listAdd(&msg, stringAt(p->label), strlen(stringAt(p->label)) + 1);
+				addErrorMessage("label dependency cycle: %s", LIST_BEG(&msg, char));
+				listZero(&msg);
+				goto REPORT_END;
+			}
+		}
+		listAdd(&chain, &p->label, 1);
+
+		// continue with the unresolved command that creates the label
+		struct Pending* q = listBeg(&pendingList);
+		for(; q != listEnd(&pendingList); ++q){
+			struct Command* qc = listAt(&q->file->commands, q->cmd);
+			if(qc->id != CID_NULL && createdName(qc) == p->label){
+				break;
+			}
+		}
+		if(q == listEnd(&pendingList)){
+			break;
+		}
+		p = q;
+	}
+	struct Label* l = findLabel(p->label);
+	if(l){
+		addErrorMessage("label \"%s\" is an allocation and has no address while evaluating commands", stringAt(p->label));
+	}else{
+		addErrorMessage("label \"%s\" is never defined", stringAt(p->label));
+	}
+
+REPORT_END:
+	listZero(&chain);
+	addErrorMessage("in file \"%s\": failed to evaluate command expression: %s", f->name, printExpr(f, commandExpr(f, c)));
+}
+
+bool resolveCommands(void){
+	// first attempt of every command in order, unresolved ones start waiting on a label
+	for(int fn = 0; fn < fssize; ++fn){
+		struct FileData* f = filesArray + fn;
+		traceBegin("commandEval", f->name);
+		for(size_t a = 0; a < f->commands.elementCount; ++a){
+			if(LIST_AT(&f->commands, struct Command, a)->id == CID_NULL){
+				continue;
+			}
+			tryCommand(f, a, SIZE_MAX);
+			// work through everything the command made resolvable
+			while(workList.elementCount){
+				size_t pidx = LIST_BEG(&workList, size_t)[--workList.elementCount];
+				struct Pending* p = listAt(&pendingList, pidx);
+				tryCommand(p->file, p->cmd, pidx);
+			}
+		}
+		traceEnd();
+	}
+
+	bool resolved = true;
+	for(struct Pending* p = listBeg(&pendingList); p != listEnd(&pendingList); ++p){
+		if(LIST_AT(&p->file->commands, struct Command, p->cmd)->id != CID_NULL){
+			resolved = false;
+			break;
+		}
+	}
+	if(!resolved){
+		reportUnresolved();
+	}
+	listZero(&pendingList);
+	listZero(&waitHeads);
+	listZero(&workList);
+	return resolved;
 }
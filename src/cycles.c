@@ -0,0 +1,360 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include "cycles.h"
+#include "types.h"
+#include "utility.h"
+#include "list.h"
+#include "error.h"
+#include "ins_values.h"
+#include "commandeval.h"
+#include "stringmanip.h"
+#include "symbols.h"
+#include "expr.h"
+
+// no node, a path ends there
+#define NO_NODE -1
+// worst case of a path that can loop forever
+#define UNBOUNDED -1
+// worst case when no path reaches the end asked for
+#define NO_PATH -2
+// best case of a path that never ends
+#define NEVER LONG_MAX
+// stop of worstFrom for paths that end at an rti
+#define TO_RTI -2
+
+// an instruction of the image as a node of the control flow graph
+struct Node{
+	uint32_t offset;	// address of the instruction
+	uint8_t opcode;
+	uint8_t size;
+	bool falls;		// control can go on to the instruction after it
+	bool jumps;		// control can go to the address of its branch or jmp
+	int next;		// node of the instruction after it, NO_NODE if none starts there
+	int jump;		// node its branch or jmp goes to, NO_NODE if none starts there
+	int call;		// node its jsr calls, NO_NODE if none starts there
+};
+
+// a node the depth first search of worstFrom is in and the next of its successors to visit
+struct Frame{
+	int node;
+	int child;
+};
+
+static struct Node* nodes;
+static int nodeCount;
+static long* worst;		// worst case cycles from each node to the end of its path, UNBOUNDED if it can reach a loop
+static uint8_t* worstState;	// 0 not visited, 1 on the search stack, 2 done
+static long* best;		// best case cycles from each node to the end of its path, NEVER if every path loops
+static struct List frames = {.allocStep = 256, .elementSize = sizeof(struct Frame)};
+
+static int compareNodes(const void* a, const void* b){
+	const struct Node* na = a;
+	const struct Node* nb = b;
+	return (na->offset > nb->offset) - (na->offset < nb->offset);
+}
+
+// return the node of the instruction starting at address addr, NO_NODE if there is none
+static int nodeAt(uint32_t addr){
+	int lo = 0, hi = nodeCount;
+	while(lo < hi){
+		int mid = (lo + hi) / 2;
+		if(nodes[mid].offset < addr){
+			lo = mid + 1;
+		}else{
+			hi = mid;
+		}
+	}
+	return lo < nodeCount && nodes[lo].offset == addr ? lo : NO_NODE;
+}
+
+// collect the instructions of every file and link each to the ones control can go to from it
+// targets are read from the finished image, so this is done once everything is placed
+static void buildGraph(void){
+	if(nodes){
+		return;
+	}
+	for(int z = 0; z < fssize; ++z){
+		nodeCount += filesArray[z].instructions.elementCount;
+	}
+	nodes = malloc(sizeof(struct Node) * (nodeCount ? nodeCount : 1));
+	worst = malloc(sizeof(long) * (nodeCount ? nodeCount : 1));
+	worstState = calloc(nodeCount ? nodeCount : 1, 1);
+	best = malloc(sizeof(long) * (nodeCount ? nodeCount : 1));
+	testError(!nodes || !worst || !worstState || !best, "control flow graph alloc fail");
+	struct Node* n = nodes;
+	for(int z = 0; z < fssize; ++z){
+		for(struct Instruction* i = listBeg(&filesArray[z].instructions); i != listEnd(&filesArray[z].instructions); ++i){
+			*n++ = (struct Node){.offset = i->offset, .opcode = i->opcode, .size = i->size};
+		}
+	}
+	qsort(nodes, nodeCount, sizeof(struct Node), compareNodes);
+
+	for(n = nodes; n != nodes + nodeCount; ++n){
+		uint32_t end = n->offset + n->size;
+		uint32_t word = n->size == 3 ? memImage[n->offset + 1] | memImage[n->offset + 2] << 8 : 0;
+		uint32_t target = n->size >= 2 ? end + (int8_t)memImage[n->offset + 1] : end;
+		switch(n->opcode){
+			case OPC_RTS_S:
+			case OPC_RTI_S:
+			case OPC_BRK_S:
+			case OPC_STP_I:
+			case OPC_JMP_ABSI:
+			case OPC_JMP_ABSII:
+				break;
+			case OPC_JMP_ABS:
+				n->jumps = true;
+				target = word;
+				break;
+			case OPC_BRA_R:
+				n->jumps = true;
+				break;
+			default:
+				n->falls = true;
+				n->jumps = opcodeCycles[n->opcode] & CYCLES_BRANCH;
+		}
+		n->next = n->falls ? nodeAt(end) : NO_NODE;
+		n->jump = n->jumps ? nodeAt(target) : NO_NODE;
+		n->call = n->opcode == OPC_JSR_ABS ? nodeAt(word) : NO_NODE;
+	}
+}
+
+// return the cycles node n takes when it goes to the address of its branch or jmp
+static long jumpCycles(const struct Node* n){
+	long c = opcodeCycles[n->opcode] & CYCLES_MASK;
+	if(opcodeCycles[n->opcode] & CYCLES_BRANCH){
+		uint32_t end = n->offset + n->size, target = end + (int8_t)memImage[n->offset + 1];
+		c += 1 + ((end ^ target) & 0xFF00 ? 1 : 0);
+	}
+	return c;
+}
+
+// set the nodes that can't reach node stop, or an rti for stop TO_RTI, done with NO_PATH so worstFrom never follows them
+// a loop they are in then can't make a path that does reach stop unbounded, state must be all 0
+static void markNoPath(int stop, long* memo, uint8_t* state){
+	// 3 marks the nodes found to reach stop so far, going backwards finds code that only falls through and branches forward in one pass
+	for(bool changed = true; changed;){
+		changed = false;
+		for(int a = nodeCount - 1; a >= 0; --a){
+			const struct Node* n = nodes + a;
+			bool reaches = a == stop || (stop == TO_RTI && n->opcode == OPC_RTI_S)
+				|| (n->falls && n->next != NO_NODE && state[n->next] == 3) || (n->jumps && n->jump != NO_NODE && state[n->jump] == 3);
+			if(reaches && state[a] != 3){
+				state[a] = 3;
+				changed = true;
+			}
+		}
+	}
+	for(int a = 0; a < nodeCount; ++a){
+		memo[a] = NO_PATH;
+		state[a] = state[a] == 3 ? 0 : 2;
+	}
+}
+
+// worst case cycles from node start to the end of its path
+// with stop NO_NODE every path counts, the results are kept in worst for every node visited and a jsr adds the worst case of what it calls
+// otherwise only paths that reach node stop, or end at an rti for stop TO_RTI, count and NO_PATH is returned if there are none
+// the worst cases of calls are then taken from worst, which must be done for them
+static long worstFrom(int start, int stop, long* memo, uint8_t* state){
+	if(stop != NO_NODE && !state[start]){
+		markNoPath(stop, memo, state);
+	}
+	if(state[start] == 2){
+		return memo[start];
+	}
+	frames.elementCount = 0;
+	state[start] = 1;
+	LIST_ADD(&frames, struct Frame, &((struct Frame){.node = start}), 1);
+	while(frames.elementCount){
+		struct Frame* fr = LIST_AT(&frames, struct Frame, frames.elementCount - 1);
+		const struct Node* n = nodes + fr->node;
+		int succ[3] = {stop == NO_NODE ? n->call : NO_NODE, n->next, n->jump};
+		if(fr->child < 3){
+			int s = succ[fr->child++];
+			if(s != NO_NODE && s != stop && !state[s]){
+				state[s] = 1;
+				LIST_ADD(&frames, struct Frame, &((struct Frame){.node = s}), 1);
+			}
+			continue;
+		}
+
+		// a successor still on the stack closes a loop, a path that leaves the code only counts when every path does
+		long v[3];
+		for(int a = 0; a < 3; ++a){
+			v[a] = succ[a] == stop ? 0 : succ[a] == NO_NODE ? (stop == NO_NODE || a == 0 ? 0 : NO_PATH) : state[succ[a]] == 1 ? UNBOUNDED : memo[succ[a]];
+		}
+		if(n->call != NO_NODE && stop != NO_NODE){
+			v[0] = worst[n->call];
+		}
+		long base = opcodeCycles[n->opcode] & CYCLES_MASK;
+		long fall = NO_PATH, jump = NO_PATH;
+		if(n->falls){
+			fall = v[0] == UNBOUNDED || v[1] == UNBOUNDED ? UNBOUNDED : v[1] == NO_PATH ? NO_PATH : base + (opcodeCycles[n->opcode] & CYCLES_PAGE ? 1 : 0) + v[0] + v[1];
+		}else if(!n->jumps && (stop == NO_NODE || (stop == TO_RTI && n->opcode == OPC_RTI_S))){
+			fall = base;
+		}
+		if(n->jumps){
+			jump = v[2] == UNBOUNDED || v[2] == NO_PATH ? v[2] : jumpCycles(n) + v[2];
+		}
+		long w = fall == UNBOUNDED || jump == UNBOUNDED ? UNBOUNDED : fall > jump ? fall : jump;
+		memo[fr->node] = w;
+		state[fr->node] = 2;
+		--frames.elementCount;
+	}
+	return memo[start];
+}
+
+// add a to b for best cases, NEVER stays NEVER
+static long addBest(long a, long b){
+	return a == NEVER || b == NEVER ? NEVER : a + b;
+}
+
+// find the best case of every node into out, going over them again until none gets better
+// with toRti only paths that end at an rti count, the best cases of calls are then taken from best, which must be done for them
+// going backwards settles code that only falls through and branches forward in one pass
+static void computeBest(long* out, bool toRti){
+	for(int a = 0; a < nodeCount; ++a){
+		out[a] = NEVER;
+	}
+	long end = toRti ? NEVER : 0;
+	for(bool changed = true; changed;){
+		changed = false;
+		for(int a = nodeCount - 1; a >= 0; --a){
+			const struct Node* n = nodes + a;
+			long b = NEVER;
+			if(n->falls){
+				long c = opcodeCycles[n->opcode] & CYCLES_MASK;
+				c = addBest(c, n->call == NO_NODE ? 0 : best[n->call]);
+				b = addBest(c, n->next == NO_NODE ? end : out[n->next]);
+			}else if(!n->jumps && (!toRti || n->opcode == OPC_RTI_S)){
+				b = opcodeCycles[n->opcode] & CYCLES_MASK;
+			}
+			if(n->jumps){
+				long c = addBest(jumpCycles(n), n->jump == NO_NODE ? end : out[n->jump]);
+				b = c < b ? c : b;
+			}
+			if(b < out[a]){
+				out[a] = b;
+				changed = true;
+			}
+		}
+	}
+}
+
+// find the worst case of every node
+static void computeWorst(void){
+	for(int a = 0; a < nodeCount; ++a){
+		worstFrom(a, NO_NODE, worst, worstState);
+	}
+}
+
+bool checkCycles(void){
+	if(!cycleChecks.elementCount){
+		return true;
+	}
+	buildGraph();
+	computeWorst();
+	long* memo = malloc(sizeof(long) * (nodeCount ? nodeCount : 1));
+	uint8_t* state = malloc(nodeCount ? nodeCount : 1);
+	testError(!memo || !state, "cycle check alloc fail");
+	bool ok = true;
+	for(struct CycleCheck* c = listBeg(&cycleChecks); c != listEnd(&cycleChecks); ++c){
+		struct FileData* f = filesArray + c->file;
+		int from = nodeAt(c->fromAddr), to = nodeAt(c->toAddr);
+		if(from == NO_NODE || to == NO_NODE){
+			addErrorMessage("in file \"%s\": .CYCLES address %.4X is not the start of an instruction: %s", f->name, from == NO_NODE ? c->fromAddr : c->toAddr, printExpr(f, exprPieces(f, from == NO_NODE ? c->from : c->to)));
+			ok = false;
+			continue;
+		}
+		memset(state, 0, nodeCount);
+		long w = worstFrom(from, to, memo, state);
+		if(w == UNBOUNDED){
+			addErrorMessage("in file \"%s\": .CYCLES from %.4X can loop forever without reaching %.4X: %s", f->name, c->fromAddr, c->toAddr, printExpr(f, exprPieces(f, c->from)));
+			ok = false;
+		}else if(w == NO_PATH){
+			addErrorMessage("in file \"%s\": .CYCLES from %.4X never reaches %.4X: %s", f->name, c->fromAddr, c->toAddr, printExpr(f, exprPieces(f, c->from)));
+			ok = false;
+		}else if(w > c->max){
+			addErrorMessage("in file \"%s\": .CYCLES from %.4X to %.4X takes up to %ld cycles, more than %d: %s", f->name, c->fromAddr, c->toAddr, w, c->max, printExpr(f, exprPieces(f, c->from)));
+			ok = false;
+		}
+	}
+	free(memo);
+	free(state);
+	listZero(&cycleChecks);
+	return ok;
+}
+
+// a label at the start of an instruction
+struct Routine{
+	uint32_t name;
+	int node;
+};
+
+static int compareRoutines(const void* a, const void* b){
+	const struct Routine* ra = a;
+	const struct Routine* rb = b;
+	return (ra->node > rb->node) - (ra->node < rb->node);
+}
+
+// print a best and worst case plus extra cycles as cycle counts, or as never ending and looping
+static void printCase(long b, long w, long extra){
+	if(b == NEVER){
+		printf("%8s", "never");
+	}else{
+		printf("%8ld", b + extra);
+	}
+	if(w == UNBOUNDED){
+		printf("%8s", "loop");
+	}else if(w == NO_PATH){
+		printf("%8s", "never");
+	}else{
+		printf("%8ld", w + extra);
+	}
+}
+
+void printCycles(void){
+	buildGraph();
+	computeWorst();
+	computeBest(best, false);
+
+	struct List routines = listNew(sizeof(struct Routine), 64);
+	for(int z = 0; z < fssize; ++z){
+		for(struct Label* l = listBeg(&filesArray[z].labels); l != listEnd(&filesArray[z].labels); ++l){
+			int n = l->value >= 0 ? nodeAt(l->value) : NO_NODE;
+			if(n != NO_NODE){
+				LIST_ADD(&routines, struct Routine, &((struct Routine){.name = l->name, .node = n}), 1);
+			}
+		}
+	}
+	qsort(listBeg(&routines), routines.elementCount, sizeof(struct Routine), compareRoutines);
+
+	printf("cycles from each code label to the rts, rti or jump that ends its path:\n");
+	printf("%6s%8s%8s  %s\n", "ADDR", "BEST", "WORST", "LABEL");
+	for(struct Routine* r = listBeg(&routines); r != listEnd(&routines); ++r){
+		printf("  %.4X", nodes[r->node].offset);
+		printCase(best[r->node], worst[r->node], 0);
+		printf("  %s\n", stringAt(r->name));
+	}
+	listZero(&routines);
+
+	int intName = findString("__INTERRUPT", 11);
+	struct Label* l = intName < 0 ? NULL : findLabel(intName);
+	int n = l ? nodeAt(l->value) : NO_NODE;
+	if(n != NO_NODE){
+		long* toRti = malloc(sizeof(long) * nodeCount);
+		uint8_t* state = calloc(nodeCount, 1);
+		long* memo = malloc(sizeof(long) * nodeCount);
+		testError(!toRti || !state || !memo, "interrupt cycles alloc fail");
+		computeBest(toRti, true);
+		printf("taking the interrupt and running __INTERRUPT to its rti:");
+		// the 65C02 takes 7 cycles to push the return address and status and read the vector
+		printCase(toRti[n], worstFrom(n, TO_RTI, memo, state), 7);
+		printf("\n");
+		free(toRti);
+		free(state);
+		free(memo);
+	}
+}
@@ -1,15 +1,16 @@
 #include "error.h"
+#include "stats.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 
-struct List errorList = {.allocStep = 100, .elementSize = sizeof(char)};
-int errorLine = 0;
-static int msgCount = 0; // current number of messages ready to print
+_Thread_local struct List errorList = {.allocStep = 100, .elementSize = sizeof(char)};
+_Thread_local int errorLine = 0;
+static _Thread_local int msgCount = 0; // current number of messages ready to print
 
 void addErrorMessage(const char* s, ...){
-	static char errbuf[200] = {0};
+	static _Thread_local char errbuf[200] = {0};
 	va_list arg;
 	va_start(arg, s);
 	if(vsnprintf(errbuf, sizeof(errbuf), s, arg) < 0){
@@ -17,6 +18,7 @@ void addErrorMessage(const char* s, ...){
 	}
 	listAdd(&errorList, errbuf, strlen(errbuf));
 	listAdd(&errorList, "\n", 1);
+	STAT_MAX(errorBytes, errorList.bytesAllocated);
 	++msgCount;
 	va_end(arg);
 }
@@ -31,7 +33,7 @@ void simpleError(const char* s, ...){
 }
 
 void printErrorsExit(void){
-	char* pos = listBeg(errorList);
+	char* pos = listBeg(&errorList);
 	while(msgCount > 0){
 		for(int idx = 0; idx < msgCount - 1; ++idx){
 			pos = strchr(pos, '\n');
@@ -46,7 +48,7 @@ void printErrorsExit(void){
 			exit(EXIT_FAILURE);
 		}
 		fprintf(stderr, "%s\n", pos);
-		pos = listBeg(errorList);
+		pos = listBeg(&errorList);
 		--msgCount;
 	}
 	exit(EXIT_FAILURE);
@@ -56,3 +58,21 @@ void clearErrors(void){
 	msgCount = 0;
 	listZero(&errorList);
 }
+
+struct List takeErrors(void){
+	struct List msgs = errorList;
+	errorList.data = NULL;
+	listZero(&errorList);
+	msgCount = 0;
+	return msgs;
+}
+
+void putErrors(struct List msgs){
+	for(char* c = listBeg(&msgs); c != listEnd(&msgs); ++c){
+		if(*c == '\n'){
+			++msgCount;
+		}
+	}
+	listAdd(&errorList, listBeg(&msgs), msgs.elementCount);
+	listZero(&msgs);
+}
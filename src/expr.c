@@ -0,0 +1,96 @@
+#include "expr.h"
+#include "list.h"
+#include "error.h"
+#include "utility.h"
+#include "stringmanip.h"
+#include "symbols.h"
+#include "stats.h"
+#include <stdint.h>
+
+_Thread_local size_t missingLabel = SIZE_MAX;
+
+/*
+ * the source form applies every value to a running result starting at 0
+ * values are collected until an operator, which then applies each collected value in order
+ * any values left at the end are added
+ * so each value compiles to one step holding the operator that applies it
+ */
+size_t compileExpression(size_t p, struct FileData* f){
+	struct Expr e = {.code = f->code.elementCount, .piece = p};
+	size_t pending = e.code; // first step whose operator is not known yet
+	for(; !IS_EXPR_END(pieceType(f, p)); ++p){
+		struct ExprOp op = {.op = PT_ADD};
+		switch(pieceType(f, p)){
+			case PT_STRING:
+				op.label = true;
+				op.name = pieceString(f, p);
+				listAdd(&f->code, &op, 1);
+				break;
+			case PT_INTEGER:
+				op.integer = pieceInteger(f, p);
+				listAdd(&f->code, &op, 1);
+				break;
+			case PT_ADD:
+			case PT_SUB:
+			case PT_RSHIFT:
+			case PT_LSHIFT:
+				for(; pending < f->code.elementCount; ++pending){
+					LIST_AT(&f->code, struct ExprOp, pending)->op = pieceType(f, p);
+				}
+				break;
+			default:
+				f->code.elementCount = e.code;
+				addErrorMessage("piece type not good for evaluation sequence");
+				return EXPR_NONE;
+		}
+	}
+	e.len = f->code.elementCount - e.code;
+	listAdd(&f->exprs, &e, 1);
+	return f->exprs.elementCount - 1;
+}
+
+void dropExpressions(struct FileData* f, size_t expr){
+	f->code.elementCount = LIST_AT(&f->exprs, struct Expr, expr)->code;
+	f->exprs.elementCount = expr;
+}
+
+bool evalExpression(struct FileData* f, size_t expr, int* res){
+	STAT_ADD(evalCalls, 1);
+	const struct Expr* e = listAt(&f->exprs, expr);
+	const struct ExprOp* op = LIST_BEG(&f->code, struct ExprOp) + e->code;
+	int result = 0;
+	for(const struct ExprOp* end = op + e->len; op != end; ++op){
+		int v = op->integer;
+		if(op->label){
+			// use the label only if it is defined
+			STAT_ADD(labelLookups, 1);
+			const struct Label* l = findLabel(op->name);
+			if(!l || l->type != LT_DEFINED){
+				missingLabel = op->name;
+				addErrorMessage("string \"%s\" did not match any defined labels", stringAt(op->name));
+				return false;
+			}
+			v = l->value;
+		}
+		switch(op->op){
+			case PT_ADD:
+				result += v;
+				break;
+			case PT_SUB:
+				result -= v;
+				break;
+			case PT_RSHIFT:
+				result >>= v;
+				break;
+			case PT_LSHIFT:
+				result <<= v;
+				break;
+		}
+	}
+	*res = result;
+	return true;
+}
+
+size_t exprPieces(struct FileData* f, size_t expr){
+	return LIST_AT(&f->exprs, struct Expr, expr)->piece;
+}
@@ -314,7 +314,7 @@ const short opcodes[][16] = {
 		[AM_ABSY] = OPC_LDX_ABSY + 1,
 		[AM_IM] = OPC_LDX_IM + 1,
 		[AM_ZP] = OPC_LDX_ZP + 1,
-		[AM_ZPY] = OPC_LDX_ZPY
+		[AM_ZPY] = OPC_LDX_ZPY + 1,
 	},
 	[IN_LDY] = {
 		[AM_ABS] = OPC_LDY_ABS + 1,
@@ -472,7 +472,7 @@ const short opcodes[][16] = {
 	[IN_STX] = {
 		[AM_ABS] = OPC_STX_ABS + 1,
 		[AM_ZP] = OPC_STX_ZP + 1,
-		[AM_ZPY] = OPC_STX_ZPY
+		[AM_ZPY] = OPC_STX_ZPY + 1,
 	},
 	[IN_STY] = {
 		[AM_ABS] = OPC_STY_ABS + 1,
@@ -534,3 +534,219 @@ const char flagsList[][3] = {
 	[AM_ZPI] = {'Z', 'N'},
 	[AM_ZPIIY] = {'Z', 'N', 'Y'}
 };
+
+// cycles of each opcode on the 65C02, in opcode list order
+const unsigned char opcodeCycles[256] = {
+	[OPC_ADC_ZPII] = 6,
+	[OPC_ADC_ZP] = 3,
+	[OPC_ADC_IM] = 2,
+	[OPC_ADC_ABS] = 4,
+	[OPC_ADC_ZPIIY] = 5 | CYCLES_PAGE,
+	[OPC_ADC_ZPI] = 5,
+	[OPC_ADC_ZPX] = 4,
+	[OPC_ADC_ABSY] = 4 | CYCLES_PAGE,
+	[OPC_ADC_ABSX] = 4 | CYCLES_PAGE,
+	[OPC_AND_ZPII] = 6,
+	[OPC_AND_ZP] = 3,
+	[OPC_AND_IM] = 2,
+	[OPC_AND_ABS] = 4,
+	[OPC_AND_ZPIIY] = 5 | CYCLES_PAGE,
+	[OPC_AND_ZPI] = 5,
+	[OPC_AND_ZPX] = 4,
+	[OPC_AND_ABSY] = 4 | CYCLES_PAGE,
+	[OPC_AND_ABSX] = 4 | CYCLES_PAGE,
+	[OPC_ASL_ZP] = 5,
+	[OPC_ASL_ACC] = 2,
+	[OPC_ASL_ABS] = 6,
+	[OPC_ASL_ZPX] = 6,
+	[OPC_ASL_ABSX] = 6 | CYCLES_PAGE,
+	[OPC_BBR0_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBR1_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBR2_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBR3_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBR4_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBR5_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBR6_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBR7_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBS0_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBS1_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBS2_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBS3_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBS4_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBS5_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBS6_R] = 5 | CYCLES_BRANCH,
+	[OPC_BBS7_R] = 5 | CYCLES_BRANCH,
+	[OPC_BCC_R] = 2 | CYCLES_BRANCH,
+	[OPC_BCS_R] = 2 | CYCLES_BRANCH,
+	[OPC_BEQ_R] = 2 | CYCLES_BRANCH,
+	[OPC_BIT_ZP] = 3,
+	[OPC_BIT_ABS] = 4,
+	[OPC_BIT_ZPX] = 4,
+	[OPC_BIT_ABSX] = 4 | CYCLES_PAGE,
+	[OPC_BIT_IM] = 2,
+	[OPC_BMI_R] = 2 | CYCLES_BRANCH,
+	[OPC_BNE_R] = 2 | CYCLES_BRANCH,
+	[OPC_BPL_R] = 2 | CYCLES_BRANCH,
+	[OPC_BRA_R] = 2 | CYCLES_BRANCH,
+	[OPC_BRK_S] = 7,
+	[OPC_BVC_R] = 2 | CYCLES_BRANCH,
+	[OPC_BVS_R] = 2 | CYCLES_BRANCH,
+	[OPC_CLC_I] = 2,
+	[OPC_CLD_I] = 2,
+	[OPC_CLI_I] = 2,
+	[OPC_CLV_I] = 2,
+	[OPC_CMP_ZPII] = 6,
+	[OPC_CMP_ZP] = 3,
+	[OPC_CMP_IM] = 2,
+	[OPC_CMP_ABS] = 4,
+	[OPC_CMP_ZPIIY] = 5 | CYCLES_PAGE,
+	[OPC_CMP_ZPI] = 5,
+	[OPC_CMP_ZPX] = 4,
+	[OPC_CMP_ABSY] = 4 | CYCLES_PAGE,
+	[OPC_CMP_ABSX] = 4 | CYCLES_PAGE,
+	[OPC_CPX_IM] = 2,
+	[OPC_CPX_ZP] = 3,
+	[OPC_CPX_ABS] = 4,
+	[OPC_CPY_IM] = 2,
+	[OPC_CPY_ZP] = 3,
+	[OPC_CPY_ABS] = 4,
+	[OPC_DEC_ACC] = 2,
+	[OPC_DEC_ZP] = 5,
+	[OPC_DEC_ABS] = 6,
+	[OPC_DEC_ZPX] = 6,
+	[OPC_DEC_ABSX] = 7,
+	[OPC_DEX_I] = 2,
+	[OPC_DEY_I] = 2,
+	[OPC_EOR_ZPII] = 6,
+	[OPC_EOR_ZP] = 3,
+	[OPC_EOR_IM] = 2,
+	[OPC_EOR_ABS] = 4,
+	[OPC_EOR_ZPIIY] = 5 | CYCLES_PAGE,
+	[OPC_EOR_ZPI] = 5,
+	[OPC_EOR_ZPX] = 4,
+	[OPC_EOR_ABSY] = 4 | CYCLES_PAGE,
+	[OPC_EOR_ABSX] = 4 | CYCLES_PAGE,
+	[OPC_INC_ACC] = 2,
+	[OPC_INC_ZP] = 5,
+	[OPC_INC_ABS] = 6,
+	[OPC_INC_ZPX] = 6,
+	[OPC_INC_ABSX] = 7,
+	[OPC_INX_I] = 2,
+	[OPC_INY_I] = 2,
+	[OPC_JMP_ABS] = 3,
+	[OPC_JMP_ABSI] = 6,
+	[OPC_JMP_ABSII] = 6,
+	[OPC_JSR_ABS] = 6,
+	[OPC_LDA_ZPII] = 6,
+	[OPC_LDA_ZP] = 3,
+	[OPC_LDA_IM] = 2,
+	[OPC_LDA_ABS] = 4,
+	[OPC_LDA_ZPIIY] = 5 | CYCLES_PAGE,
+	[OPC_LDA_ZPI] = 5,
+	[OPC_LDA_ZPX] = 4,
+	[OPC_LDA_ABSY] = 4 | CYCLES_PAGE,
+	[OPC_LDA_ABSX] = 4 | CYCLES_PAGE,
+	[OPC_LDX_IM] = 2,
+	[OPC_LDX_ZP] = 3,
+	[OPC_LDX_ABS] = 4,
+	[OPC_LDX_ZPY] = 4,
+	[OPC_LDX_ABSY] = 4 | CYCLES_PAGE,
+	[OPC_LDY_IM] = 2,
+	[OPC_LDY_ZP] = 3,
+	[OPC_LDY_ABS] = 4,
+	[OPC_LDY_ZPX] = 4,
+	[OPC_LDY_ABSX] = 4 | CYCLES_PAGE,
+	[OPC_LSR_ZP] = 5,
+	[OPC_LSR_ACC] = 2,
+	[OPC_LSR_ABS] = 6,
+	[OPC_LSR_ZPX] = 6,
+	[OPC_LSR_ABSX] = 6 | CYCLES_PAGE,
+	[OPC_NOP_I] = 2,
+	[OPC_ORA_ZPII] = 6,
+	[OPC_ORA_ZP] = 3,
+	[OPC_ORA_IM] = 2,
+	[OPC_ORA_ABS] = 4,
+	[OPC_ORA_ZPIIY] = 5 | CYCLES_PAGE,
+	[OPC_ORA_ZPI] = 5,
+	[OPC_ORA_ZPX] = 4,
+	[OPC_ORA_ABSY] = 4 | CYCLES_PAGE,
+	[OPC_ORA_ABSX] = 4 | CYCLES_PAGE,
+	[OPC_PHA_S] = 3,
+	[OPC_PHP_S] = 3,
+	[OPC_PHX_S] = 3,
+	[OPC_PHY_S] = 3,
+	[OPC_PLA_S] = 4,
+	[OPC_PLP_S] = 4,
+	[OPC_PLX_S] = 4,
+	[OPC_PLY_S] = 4,
+	[OPC_RMB0_ZP] = 5,
+	[OPC_RMB1_ZP] = 5,
+	[OPC_RMB2_ZP] = 5,
+	[OPC_RMB3_ZP] = 5,
+	[OPC_RMB4_ZP] = 5,
+	[OPC_RMB5_ZP] = 5,
+	[OPC_RMB6_ZP] = 5,
+	[OPC_RMB7_ZP] = 5,
+	[OPC_ROL_ZP] = 5,
+	[OPC_ROL_ACC] = 2,
+	[OPC_ROL_ABS] = 6,
+	[OPC_ROL_ZPX] = 6,
+	[OPC_ROL_ABSX] = 6 | CYCLES_PAGE,
+	[OPC_ROR_ZP] = 5,
+	[OPC_ROR_ACC] = 2,
+	[OPC_ROR_ABS] = 6,
+	[OPC_ROR_ZPX] = 6,
+	[OPC_ROR_ABSX] = 6 | CYCLES_PAGE,
+	[OPC_RTI_S] = 6,
+	[OPC_RTS_S] = 6,
+	[OPC_SBC_ZPII] = 6,
+	[OPC_SBC_ZP] = 3,
+	[OPC_SBC_IM] = 2,
+	[OPC_SBC_ABS] = 4,
+	[OPC_SBC_ZPIIY] = 5 | CYCLES_PAGE,
+	[OPC_SBC_ZPI] = 5,
+	[OPC_SBC_ZPX] = 4,
+	[OPC_SBC_ABSY] = 4 | CYCLES_PAGE,
+	[OPC_SBC_ABSX] = 4 | CYCLES_PAGE,
+	[OPC_SEC_I] = 2,
+	[OPC_SED_I] = 2,
+	[OPC_SEI_I] = 2,
+	[OPC_SMB0_ZP] = 5,
+	[OPC_SMB1_ZP] = 5,
+	[OPC_SMB2_ZP] = 5,
+	[OPC_SMB3_ZP] = 5,
+	[OPC_SMB4_ZP] = 5,
+	[OPC_SMB5_ZP] = 5,
+	[OPC_SMB6_ZP] = 5,
+	[OPC_SMB7_ZP] = 5,
+	[OPC_STA_ZPII] = 6,
+	[OPC_STA_ZP] = 3,
+	[OPC_STA_ABS] = 4,
+	[OPC_STA_ZPIIY] = 6,
+	[OPC_STA_ZPI] = 5,
+	[OPC_STA_ZPX] = 4,
+	[OPC_STA_ABSY] = 5,
+	[OPC_STA_ABSX] = 5,
+	[OPC_STP_I] = 3,
+	[OPC_STX_ZP] = 3,
+	[OPC_STX_ABS] = 4,
+	[OPC_STX_ZPY] = 4,
+	[OPC_STY_ZP] = 3,
+	[OPC_STY_ABS] = 4,
+	[OPC_STY_ZPX] = 4,
+	[OPC_STZ_ZP] = 3,
+	[OPC_STZ_ZPX] = 4,
+	[OPC_STZ_ABS] = 4,
+	[OPC_STZ_ABSX] = 5,
+	[OPC_TAX_I] = 2,
+	[OPC_TAY_I] = 2,
+	[OPC_TRB_ZP] = 5,
+	[OPC_TRB_ABS] = 6,
+	[OPC_TSB_ZP] = 5,
+	[OPC_TSB_ABS] = 6,
+	[OPC_TSX_I] = 2,
+	[OPC_TXA_I] = 2,
+	[OPC_TXS_I] = 2,
+	[OPC_TYA_I] = 2,
+	[OPC_WAI_I] = 3,
+};
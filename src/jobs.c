@@ -0,0 +1,319 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "jobs.h"
+#include "types.h"
+#include "utility.h"
+#include "list.h"
+#include "error.h"
+#include "stringmanip.h"
+#include "ins_values.h"
+#include "expr.h"
+#include "trace.h"
+#include "stats.h"
+#include "cache.h"
+#include "object.h"
+#include "memmap.h"
+
+// state of one file scanned on a worker thread
+struct FileJob{
+	struct StringTable strings;	// strings interned while lexing the file, ids are local to the file
+	unsigned char* image;		// bytes placed by the file starting at relative address 0
+	size_t size;			// number of bytes the file takes in the image
+	int errorLine;			// line scanPieces failed at, 0 on success
+	struct List errors;		// messages added before failing
+};
+
+static struct FileJob* fileJobs;
+static atomic_int nextJob;
+
+// scan file fn at relative address 0 into its job on the calling thread
+static void scanJob(int fn){
+	struct FileJob* job = fileJobs + fn;
+	job->strings = newStringTable();
+	useStrings(&job->strings);
+	testError((job->image = calloc(ADDRESS_SPACE, 1)) == NULL, "file image buffer alloc fail (%d bytes)", ADDRESS_SPACE);
+	memImage = job->image;
+	memIdx = 0;
+
+	struct FileData* f = filesArray + fn;
+	uint64_t key = 0;
+	if(cacheDir){
+		traceBegin("cacheLoad", f->name);
+		key = cacheKey(f->name);
+		bool cached = cacheLoad(f, key);
+		traceEnd();
+		if(cached){
+			job->size = memIdx;
+			return;
+		}
+	}
+	traceBegin("createPieces", f->name);
+	createPieces(f);
+	traceEnd();
+	traceBegin("scanPieces", f->name);
+	job->errorLine = scanPieces(f);
+	traceEnd();
+	if(cacheDir && !job->errorLine){
+		traceBegin("cacheStore", f->name);
+		cacheStore(f, key, &job->strings);
+		traceEnd();
+	}
+	if(job->errorLine){
+		job->errors = takeErrors();
+	}
+	job->size = memIdx;
+}
+
+// take files in order until none are left and scan each one
+static void* scanWorker(void* arg){
+	(void)arg;
+	int fn;
+	while((fn = atomic_fetch_add(&nextJob, 1)) < fssize){
+		scanJob(fn);
+	}
+	useStrings(NULL);
+	statsFlush();
+	return NULL;
+}
+
+// move the scanned file fn to the end of its segment in the global image and give its strings global ids
+static void mergeJob(int fn){
+	struct FileJob* job = fileJobs + fn;
+	struct FileData* f = filesArray + fn;
+
+	// local ids are in order of first appearance in the file, so adding them in order gives the ids a serial scan would
+	struct List remap = listNew(sizeof(size_t), 100);
+	for(char* c = listBeg(&job->strings.chars); c != listEnd(&job->strings.chars); c += strlen(c) + 1){
+		size_t id = addString(c, strlen(c));
+		listAdd(&remap, &id, 1);
+	}
+	size_t* ids = listBeg(&remap);
+
+	// the segments are named by the file, so its names are remapped before it is placed
+	for(struct Command* c = listBeg(&f->commands); c != listEnd(&f->commands); ++c){
+		if(c->id == CID_SEGMENT){
+			c->segment.name = ids[c->segment.name];
+		}
+	}
+	assignSegments(f);
+	size_t base = placeFile(f, job->size);
+
+	uint32_t* values = listBeg(&f->pieces.values);
+	for(size_t p = 0; p < f->pieces.types.elementCount; ++p){
+		if(pieceType(f, p) == PT_STRING){
+			values[p] = ids[values[p]];
+		}
+	}
+
+	for(struct Command* c = listBeg(&f->commands); c != listEnd(&f->commands); ++c){
+		switch(c->id){
+			case CID_DROP:
+				c->drop.offset += base;
+				break;
+			case CID_DROP16:
+				c->drop16.offset += base;
+				break;
+			case CID_CONST:
+				c->constant.name = ids[c->constant.name];
+				break;
+			case CID_ALLOC:
+				c->alloc.name = ids[c->alloc.name];
+				break;
+			case CID_LABEL:
+				c->label.addr += base;
+				c->label.name = ids[c->label.name];
+				break;
+			case CID_STRING:
+				c->string.name = ids[c->string.name];
+				c->string.value = ids[c->string.value];
+				c->string.offset += base;
+				break;
+			default:
+				break;
+		}
+	}
+
+	for(struct ExprOp* op = listBeg(&f->code); op != listEnd(&f->code); ++op){
+		if(op->label){
+			op->name = ids[op->name];
+		}
+	}
+
+	memcpy(memImage + base, job->image, job->size);
+	for(struct Reloc* r = listBeg(&f->relocs); r != listEnd(&f->relocs); ++r){
+		r->offset += base;
+	}
+	for(struct Instruction* i = listBeg(&f->instructions); i != listEnd(&f->instructions); ++i){
+		i->offset += base;
+		// branch values were taken relative to the file, see getInsLine
+		if(i->mode == AM_PCR){
+			i->value += i->expr != EXPR_NONE ? (int32_t)base : -(int32_t)base;
+			memImage[i->offset + 1] = i->value;
+		}
+	}
+	listZero(&remap);
+	stringTableZero(&job->strings);
+	free(job->image);
+}
+
+void scanFiles(int jobs){
+	if(jobs > fssize){
+		jobs = fssize;
+	}
+	testError((fileJobs = calloc(fssize, sizeof(struct FileJob))) == NULL, "file job alloc fail");
+	pthread_t* threads = malloc(sizeof(pthread_t) * jobs);
+	testError(!threads, "thread list alloc fail");
+	atomic_init(&nextJob, 0);
+	for(int t = 0; t < jobs; ++t){
+		testError(pthread_create(threads + t, NULL, scanWorker, NULL), "failed to create scan thread");
+	}
+	for(int t = 0; t < jobs; ++t){
+		pthread_join(threads[t], NULL);
+	}
+	free(threads);
+}
+
+bool rescanFile(int fn){
+	// the scan runs in a child, so lexer and scanner errors that exit only end it, and the scan comes back through a scan file
+	char name[4096];
+	const char* dir = getenv("TMPDIR");
+	snprintf(name, sizeof(name), "%s/mbasm-rescan-%d", dir && *dir ? dir : "/tmp", (int)getpid());
+	fflush(NULL);
+	pid_t pid = fork();
+	testError(pid < 0, "failed to fork");
+	if(!pid){
+		struct FileJob* job = fileJobs + fn;
+		*job = (struct FileJob){0};
+		filesArray[fn] = newFileData(filesArray[fn].name);
+		scanJob(fn);
+		if(job->errorLine){
+			putErrors(job->errors);
+			addErrorMessage("from file \"%s\" on line %d", filesArray[fn].name, job->errorLine);
+			printErrorsExit();
+		}
+		bool ok = writeScan(name, SCAN_CACHE, 0, filesArray + fn, &job->strings, job->image, job->size);
+		fflush(NULL);
+		_exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+	if(!WIFEXITED(status) || WEXITSTATUS(status)){
+		unlink(name);
+		return false;
+	}
+
+	// the previous scan is only replaced once the new one is known to be good
+	struct FileJob job = {.strings = newStringTable()};
+	struct FileData f = newFileData(filesArray[fn].name);
+	testError((job.image = calloc(ADDRESS_SPACE, 1)) == NULL, "file image buffer alloc fail (%d bytes)", ADDRESS_SPACE);
+	useStrings(&job.strings);
+	bool ok = readScan(name, SCAN_CACHE, 0, &f, job.image, &job.size, NULL);
+	useStrings(NULL);
+	unlink(name);
+	if(!ok){
+		stringTableZero(&job.strings);
+		free(job.image);
+		fileDataZero(&f);
+		return false;
+	}
+	stringTableZero(&fileJobs[fn].strings);
+	free(fileJobs[fn].image);
+	listZero(&fileJobs[fn].errors);
+	fileJobs[fn] = job;
+	fileDataZero(filesArray + fn);
+	filesArray[fn] = f;
+	return true;
+}
+
+void loadObjects(void){
+	testError((fileJobs = calloc(fssize, sizeof(struct FileJob))) == NULL, "file job alloc fail");
+	struct ScanSymbols* symbols = malloc(sizeof(struct ScanSymbols) * (fssize ? fssize : 1));
+	testError(!symbols, "symbol list alloc fail");
+	unsigned char* image = memImage;
+	for(int fn = 0; fn < fssize; ++fn){
+		struct FileJob* job = fileJobs + fn;
+		struct FileData* f = filesArray + fn;
+		job->strings = newStringTable();
+		useStrings(&job->strings);
+		testError((job->image = calloc(ADDRESS_SPACE, 1)) == NULL, "file image buffer alloc fail (%d bytes)", ADDRESS_SPACE);
+		traceBegin("loadObject", f->name);
+		testError(!readScan(f->name, SCAN_OBJECT, 0, f, job->image, &job->size, symbols + fn), "\"%s\" is not an object file written by this version of mbasm", f->name);
+		traceEnd();
+		// messages name the source file like a build from source would
+		f->name = LIST_BEG(&symbols[fn].source, char);
+	}
+
+	// every label an object imports must be exported by one of them
+	struct StringTable exported = newStringTable();
+	for(int fn = 0; fn < fssize; ++fn){
+		for(uint32_t* e = listBeg(&symbols[fn].exports); e != listEnd(&symbols[fn].exports); ++e){
+			useStrings(&fileJobs[fn].strings);
+			char* name = stringAt(*e);
+			useStrings(&exported);
+			testError(!name, "object of \"%s\" is damaged", filesArray[fn].name);
+			addString(name, strlen(name));
+		}
+	}
+	int missing = 0;
+	for(int fn = fssize - 1; fn >= 0; --fn){
+		for(uint32_t* i = listEnd(&symbols[fn].imports); i != listBeg(&symbols[fn].imports);){
+			--i;
+			useStrings(&fileJobs[fn].strings);
+			char* name = stringAt(*i);
+			useStrings(&exported);
+			testError(!name, "object of \"%s\" is damaged", filesArray[fn].name);
+			if(findString(name, strlen(name)) < 0){
+				addErrorMessage("label \"%s\" used in file \"%s\" is not defined in any object", name, filesArray[fn].name);
+				++missing;
+			}
+		}
+	}
+	useStrings(NULL);
+	stringTableZero(&exported);
+	// the source names stay in use, only the symbol lists are freed
+	for(int fn = 0; fn < fssize; ++fn){
+		listZero(&symbols[fn].exports);
+		listZero(&symbols[fn].imports);
+	}
+	free(symbols);
+	memImage = image;
+	if(missing){
+		addErrorMessage("%d undefined labels", missing);
+		printErrorsExit();
+	}
+}
+
+void writeObject(int fn, const char* name){
+	struct FileJob* job = fileJobs + fn;
+	if(job->errorLine){
+		putErrors(job->errors);
+		addErrorMessage("from file \"%s\" on line %d", filesArray[fn].name, job->errorLine);
+		printErrorsExit();
+	}
+	testError(!writeScan(name, SCAN_OBJECT, 0, filesArray + fn, &job->strings, job->image, job->size), "failed to write object file \"%s\"", name);
+}
+
+void mergeFiles(void){
+	for(int fn = 0; fn < fssize; ++fn){
+		if(fileJobs[fn].errorLine){
+			putErrors(fileJobs[fn].errors);
+			addErrorMessage("from file \"%s\" on line %d", filesArray[fn].name, fileJobs[fn].errorLine);
+			printErrorsExit();
+		}
+		traceBegin("merge", filesArray[fn].name);
+		mergeJob(fn);
+		traceEnd();
+	}
+	free(fileJobs);
+	fileJobs = NULL;
+}
+
+void scanFilesParallel(int jobs){
+	scanFiles(jobs);
+	mergeFiles();
+}
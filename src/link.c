@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "link.h"
+#include "types.h"
+#include "utility.h"
+#include "list.h"
+#include "error.h"
+#include "stringmanip.h"
+#include "commandeval.h"
+#include "symbols.h"
+#include "expr.h"
+#include "trace.h"
+#include "memmap.h"
+#include "relax.h"
+#include "cycles.h"
+
+struct List imageRanges = {.allocStep = 16, .elementSize = sizeof(struct ImageRange)};
+
+static void addRange(uint32_t start, uint32_t end){
+	struct ImageRange r = {.start = start, .end = end};
+	if(r.start < r.end){
+		LIST_ADD(&imageRanges, struct ImageRange, &r, 1);
+	}
+}
+
+static int compareRanges(const void* a, const void* b){
+	const struct ImageRange* ra = a;
+	const struct ImageRange* rb = b;
+	return (ra->start > rb->start) - (ra->start < rb->start);
+}
+
+// sort the ranges and join the ones that overlap or touch in the same segment
+static void joinRanges(void){
+	struct ImageRange* r = listBeg(&imageRanges);
+	qsort(r, imageRanges.elementCount, sizeof(struct ImageRange), compareRanges);
+	size_t n = 0;
+	for(size_t a = 0; a < imageRanges.elementCount; ++a){
+		if(n && r[a].start <= r[n - 1].end && romSegmentAt(r[n - 1].start, r[a].start - r[n - 1].start + 1)){
+			if(r[a].end > r[n - 1].end){
+				r[n - 1].end = r[a].end;
+			}
+		}else{
+			r[n++] = r[a];
+		}
+	}
+	imageRanges.elementCount = n;
+
+	// the output holds the rom segments with placed bytes one after the other
+	for(struct ImageRange* p = r; p != r + n; ++p){
+		romSegmentAt(p->start, p->end - p->start)->used = true;
+	}
+	uint32_t offset = 0;
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		if(s->rom && s->used){
+			s->offset = offset;
+			offset += s->size;
+		}
+	}
+	for(struct ImageRange* p = r; p != r + n; ++p){
+		struct Segment* s = romSegmentAt(p->start, p->end - p->start);
+		p->offset = s->offset + p->start - s->start;
+	}
+}
+
+bool checkDuplicateLabels(void){
+	// every label name maps to the first label registered with it in the symbol table
+	// any other label with the same name is a duplicate
+	// files and labels are checked last to first so the messages print in source order
+	int duplicates = 0;
+	for(int z = fssize - 1; z >= 0; --z){
+		struct FileData* f = filesArray + z;
+		for(size_t a = f->labels.elementCount; a-- > 0;){
+			struct Label* l = listAt(&f->labels, a);
+			if(findLabel(l->name) != l){
+				addErrorMessage("duplicate label name found \"%s\" from files \"%s\" and \"%s\"", stringAt(l->name), labelFile(l->name)->name, f->name);
+				++duplicates;
+			}
+		}
+	}
+	if(duplicates){
+		addErrorMessage("%d duplicate label names found", duplicates);
+		return false;
+	}
+	return true;
+}
+
+bool finalizeLabels(void){
+	// labels can be finalized again after sizeInstructions moved code, so allocations start over
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		if(!s->rom){
+			s->next = s->start;
+		}
+	}
+	for(int z = 0; z < fssize; ++z){
+		// allocations of a file are taken one after the other from its ram segment
+		struct Segment* ram = fileRamSegment(filesArray + z);
+		for(struct Label* l = listBeg(&filesArray[z].labels); l != listEnd(&filesArray[z].labels); ++l){
+			if(l->type == LT_ALLOC){
+				if(!ram){
+					addErrorMessage("in file \"%s\": can't allocate \"%s\", the memory map has no ram segment", filesArray[z].name, stringAt(l->name));
+					return false;
+				}
+				if(l->value < 0 || ram->next + l->value > ram->start + ram->size){
+					addErrorMessage("in file \"%s\": allocation \"%s\" of %d bytes does not fit in segment \"%s\"", filesArray[z].name, stringAt(l->name), l->value, ram->name);
+					return false;
+				}
+				int sz = l->value;
+				l->value = ram->next;
+				ram->next += sz;
+			}
+			l->type = LT_DEFINED;
+		}
+	}
+	return true;
+}
+
+bool fixupInstructions(void){
+	for(int z = 0; z < fssize; ++z){
+		struct FileData* f = filesArray + z;
+		for(struct Reloc* r = listBeg(&f->relocs); r != listEnd(&f->relocs); ++r){
+			int v;
+			// fail if expression not evaluated
+			if(!evalExpression(f, r->expr, &v)){
+				addErrorMessage("in file \"%s\": failed to evaluate expression: %s", f->name, printExpr(f, exprPieces(f, r->expr)));
+				return false;
+			}
+			const char* problem = NULL;
+			switch(r->kind){
+				case RK_WORD:
+				case RK_ADDRESS:
+					if(v < -0x8000 || v > 0xFFFF){
+						problem = "value %d does not fit in 16 bits";
+					}
+					memImage[r->offset + 1] = v >> 8;
+					break;
+				case RK_ZERO_PAGE:
+				case RK_SHRUNK:
+					if(v < 0 || v > 0xFF){
+						problem = "value %d is not a zero page address";
+					}
+					break;
+				case RK_IMMEDIATE:
+					// the low byte of a wider value is taken, like for addresses of labels
+					break;
+				case RK_BRANCH:
+					// branches are relative to the end of the 2 byte instruction
+					v -= r->offset + 1;
+					if(v < -128 || v > 127){
+						problem = "branch distance %d is not in -128 to 127";
+					}
+					break;
+			}
+			if(problem){
+				char what[64];
+				snprintf(what, sizeof(what), problem, v);
+				addErrorMessage("in file \"%s\": %s: %s", f->name, what, printExpr(f, exprPieces(f, r->expr)));
+				return false;
+			}
+			memImage[r->offset] = v;
+		}
+	}
+	return true;
+}
+
+void placeVectors(int* start, int* interrupt){
+	// find the entry points by name
+	int startName = findString("__START", 7), intName = findString("__INTERRUPT", 11);
+	struct Label* startLabel = startName < 0 ? NULL : findLabel(startName);
+	struct Label* intLabel = intName < 0 ? NULL : findLabel(intName);
+	testError(!startLabel, "no start label");
+	testError(!intLabel, "no interrupt label");
+	*start = startLabel->value;
+	*interrupt = intLabel->value;
+	testError(!romSegmentAt(0xFFFC, 4), "the reset and interrupt vectors at FFFC are not in a rom segment of the memory map");
+	memImage[0xFFFC] = startLabel->value;
+	memImage[0xFFFD] = startLabel->value >> 8;
+	memImage[0xFFFE] = intLabel->value;
+	memImage[0xFFFF] = intLabel->value >> 8;
+
+	// do set commands last over everything
+	imageRanges.elementCount = 0;
+	for(int* p = listBeg(&setCommands); p != listEnd(&setCommands); p += 2){
+		testError(!romSegmentAt(p[0], 1), ".SET address %.4X is not in a rom segment of the memory map", p[0]);
+		memImage[p[0]] = p[1];
+		addRange(p[0], p[0] + 1);
+	}
+	listZero(&setCommands);
+
+	// code and data of the files of each segment are placed one after the other from its start
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		if(s->rom){
+			addRange(s->start, s->next);
+		}
+	}
+	addRange(0xFFFC, 0x10000);
+	joinRanges();
+}
+
+void linkFiles(int* start, int* interrupt){
+	keepCommands();
+
+	// evaluate commands
+	traceBegin("resolveCommands", NULL);
+	if(!resolveCommands()){
+		printErrorsExit();
+	}
+	traceEnd();
+
+	traceBegin("checkDuplicateLabels", NULL);
+	if(!checkDuplicateLabels()){
+		printErrorsExit();
+	}
+	traceEnd();
+
+	// adjust label values depending on type
+	traceBegin("finalizeLabels", NULL);
+	if(!finalizeLabels()){
+		printErrorsExit();
+	}
+	traceEnd();
+
+	traceBegin("optimizeInstructions", NULL);
+	if(!optimizeInstructions()){
+		printErrorsExit();
+	}
+	traceEnd();
+
+	// shrink instructions to zero page once label values are known
+	traceBegin("sizeInstructions", NULL);
+	if(!sizeInstructions()){
+		printErrorsExit();
+	}
+	traceEnd();
+
+	// form instructions fully
+	traceBegin("fixupInstructions", NULL);
+	if(!fixupInstructions()){
+		printErrorsExit();
+	}
+	traceEnd();
+
+	traceBegin("placeVectors", NULL);
+	placeVectors(start, interrupt);
+	traceEnd();
+
+	traceBegin("checkCycles", NULL);
+	if(!checkCycles()){
+		printErrorsExit();
+	}
+	traceEnd();
+}
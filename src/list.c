@@ -1,7 +1,8 @@
 #include "list.h"
 #include "error.h"
+#include "arena.h"
 #include <stdlib.h>
-#include <stdbool.h>
+#include <string.h>
 
 struct List listNew(size_t elemSize, size_t alloc){
 	struct List c = {.elementSize = elemSize, .allocStep = alloc};
@@ -9,44 +10,58 @@ struct List listNew(size_t elemSize, size_t alloc){
 }
 
 void listAdd(struct List* list, const void* data, size_t count){
-	for(size_t dataidx = 0; dataidx < count; ++dataidx){
-		// if no more space add elements
-		if(list->data == NULL || list->elementSize * list->elementCount >= list->bytesAllocated){
-			void* temp = realloc(list->data, list->bytesAllocated + list->allocStep * list->elementSize);
-			testError(!temp, "failed to reallocate space for list");
-			list->data = temp;
-			list->bytesAllocated += list->allocStep * list->elementSize;
+	size_t needed = list->elementCount + count;
+	// if no more space, at least double the space
+	if(list->data == NULL || needed * list->elementSize > list->bytesAllocated){
+		size_t capacity = list->bytesAllocated / list->elementSize * 2;
+		if(capacity < list->allocStep){
+			capacity = list->allocStep;
 		}
-		// copy into array per byte
-		if(data){
-			unsigned char* insertPoint = (unsigned char*)list->data + list->elementCount * list->elementSize;
-			for(size_t byteidx = 0; byteidx < list->elementSize; ++byteidx){
-				insertPoint[byteidx] = ((unsigned char*)data)[byteidx + dataidx * list->elementSize];
-			}
-		}
-		++list->elementCount;
+		listReserve(list, capacity < needed ? needed : capacity);
 	}
-}
-
-void* listAt(struct List list, size_t idx){
-	if(!list.data || idx >= list.elementCount){
-		return NULL;
+	if(data){
+		memcpy((unsigned char*)list->data + list->elementCount * list->elementSize, data, count * list->elementSize);
 	}
-	return (unsigned char*)list.data + idx * list.elementSize;
+	list->elementCount = needed;
 }
 
-void* listBeg(struct List list){
-	return list.data;
+void listReserve(struct List* list, size_t count){
+	size_t bytes = count * list->elementSize;
+	if(!bytes || (list->data && bytes <= list->bytesAllocated)){
+		return;
+	}
+	void* temp;
+	if(list->arena){
+		temp = arenaGrow(list->arena, list->data, list->bytesAllocated, bytes);
+	}else{
+		temp = realloc(list->data, bytes);
+		testError(!temp, "failed to reallocate space for list");
+	}
+	list->data = temp;
+	list->bytesAllocated = bytes;
 }
 
-void* listEnd(struct List list){
-	// return NULL if no data or end
-	return list.data == NULL ? NULL : (unsigned char*)list.data + list.elementSize * list.elementCount;
+void listUseArena(struct List* list, struct Arena* a){
+	void* old = list->data;
+	struct Arena* oldArena = list->arena;
+	list->arena = a;
+	list->data = NULL;
+	if(old){
+		size_t bytes = list->bytesAllocated;
+		list->bytesAllocated = 0;
+		listReserve(list, bytes / list->elementSize);
+		memcpy(list->data, old, list->elementCount * list->elementSize);
+		if(!oldArena){
+			free(old);
+		}
+	}
 }
 
 void listZero(struct List* list){
 	if(list->data){
-		free(list->data);
+		if(!list->arena){
+			free(list->data);
+		}
 		list->data = NULL;
 	}
 	list->elementCount = 0;
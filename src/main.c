@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <getopt.h>
+#include <sys/stat.h>
 #include "types.h"
 #include "utility.h"
 #include "list.h"
@@ -12,24 +13,39 @@
 #include "error.h"
 #include "stringmanip.h"
 #include "commandeval.h"
-
-#define BASE 0x8000
-#define EEPROM_IMAGE_SIZE 0x8000
+#include "symbols.h"
+#include "jobs.h"
+#include "link.h"
+#include "trace.h"
+#include "stats.h"
+#include "cache.h"
+#include "watch.h"
+#include "output.h"
+#include "memmap.h"
+#include "relax.h"
+#include "cycles.h"
+#include "sim.h"
 
 static const char* outputName = "out.mb";
-struct List stringCharsList;
-unsigned char* memImage;
-size_t memIdx = 0;
-struct FileData* filesArray;
+static bool outputGiven = false;
+static uint64_t runCycles = 0;
+static const char* foldedName = NULL;
 
-struct List setCommands;
 struct{
 	bool verbose;
 	bool list;
+	int jobs;
+	bool stats;
+	bool watch;
+	bool compile;
+	bool link;
+	bool cycles;
+	bool run;
 } static programFlags = {0};
 
 static void processArgs(int argc, char* argv[]);
 static void printVerbose(void);
+static void compileObjects(void);
 
 // get each file
 // per file:
@@ -40,18 +56,19 @@ static void printVerbose(void);
 // eval expressions and sub in
 // assemble instructions and add to image
 
-int fssize;
-
 int main(int argc, char* argv[]){
 	// little endian check
 	unsigned n = 1;
 	testError(((char*)&n)[0] != 1, "little endian check failed");
 
 	// allocate output buffer for data
-	testError((memImage = calloc(EEPROM_IMAGE_SIZE, 1)) == NULL, "eeprom image buffer alloc fail (%d bytes)", EEPROM_IMAGE_SIZE);
-	stringCharsList = listNew(1, 1000);
+	testError((memImage = calloc(ADDRESS_SPACE, 1)) == NULL, "image buffer alloc fail (%d bytes)", ADDRESS_SPACE);
 
 	processArgs(argc, argv);
+	if(!segments.elementCount){
+		defaultMemoryMap();
+	}
+	fillImage();
 	// argc total
 	// index of optind is element number optind + 1
 	// argc - (optind + 1) - 1 = argc - optind
@@ -59,135 +76,75 @@ int main(int argc, char* argv[]){
 	filesArray = malloc(sizeof(struct FileData) * fssize);
 	for(int a = 0; a < argc - optind; ++a){
 		filesArray[a] = newFileData(argv[a + optind]);
-		createPieces(filesArray + a);
-		int errorLine = scanPieces(filesArray + a);
-		if(errorLine){
-			addErrorMessage("from file \"%s\" on line %d", filesArray[a].name, errorLine);
-			printErrorsExit();
-		}
 	}
-
-	// evaluate commands
-	setCommands = listNew(sizeof(int) * 2, 50);
-	int totalCommands = 0;
-	int* commandCt = malloc(sizeof(int) * fssize);
-	for(int fn = 0; fn < fssize; ++fn){
-		totalCommands += (commandCt[fn] = filesArray[fn].commands.elementCount);
+	if(programFlags.watch){
+		watchFiles(programFlags.jobs > 1 ? programFlags.jobs : 1, outputName);
 	}
-	int completeCommands = 0;
-	while(completeCommands != totalCommands){
-		int change = 0;
-		for(int fn = 0; fn < fssize; ++fn){
-			struct FileData* cf = filesArray + fn;
-			int completed = commandEval(cf);
-			change += completed;
-			commandCt[fn] -= completed;
-		}
-		//testError(change == 0, "commands entered deadlock state, can't continue evaluation");
-		if(change == 0){
-			for(int a = 0; a < fssize; ++a){
-				fprintf(stderr, "%d left in %s\n", commandCt[a], filesArray[a].name);
-			}
-			simpleError("commands entered deadlock state, can't continue evaluation");
-		}
-		completeCommands += change;
+	if(programFlags.compile){
+		compileObjects();
+		return EXIT_SUCCESS;
 	}
-	clearErrors(); // no?
-	free(commandCt);
-
-	// this looks really bad but it isnt
-	// for each label from each file, check its string index with every other label from every file
-	// error if the string indexes match, duplicate label
-	// also adjust label values depending on type and find __START and __INTERRUPT
-	struct Label* startLabel = NULL, *intLabel = NULL;
 
-	for(int z = 0; z < fssize; ++z){
-		for(int a = 0; a < filesArray[z].labels.elementCount; ++a){
-			int csi = ((struct Label*)listAt(filesArray[z].labels, a))->name;
-			for(int b = 0; b < fssize; ++b){
-				for(int c = 0; c < filesArray[b].labels.elementCount; ++c){
-					int i = ((struct Label*)listAt(filesArray[b].labels, c))->name;
-					if(i == csi && !(z == b && a == c)){
-						simpleError("duplicate label name found \"%s\"\nfrom files \"%s\" and \"%s\"", stringAt(i), filesArray[z].name, filesArray[b].name);
-					}
-				}
-			}
-			// adjust label values to be aligned at 0x8000 offset
-			struct Label* l = listAt(filesArray[z].labels, a);
-			static int allocAddr = 0x200;
-			if(l->type == LT_UNDEFINED){
-					l->value += BASE;
-			}else if(l->type == LT_ALLOC){
-				int sz = l->value;
-				l->value = allocAddr;
-				allocAddr += sz;
-			}
-			l->type = LT_DEFINED;
-			for(struct Label* l = listBeg(filesArray[z].labels); l != listEnd(filesArray[z].labels); ++l){
-				char* str = stringAt(l->name);
-				if(!strcmp(str, "__START")){
-					startLabel = l;
-				}else if(!strcmp(str, "__INTERRUPT")){
-					intLabel = l;
-				}
-			}
-		}
-	}
-
-	// form instructions fully
-	for(int z = 0; z < fssize; ++z){
-		for(struct Instruction* i = listBeg(filesArray[z].instructions); i != listEnd(filesArray[z].instructions); ++i){
-			// eval expression if needed
-			if(!i->expr){
-				continue;
-			}
-			int v;
-			// fail if expression not evaluated
-			if(!evalExpression(listAt(filesArray[z].pieces, i->expr), &v)){
-				//addErrorMessage(printExpr(listAt(filesArray[z].pieces, i->expr)));
-				addErrorMessage("in file \"%s\": failed to evaluate expression:\n%s", filesArray[z].name, printExpr(listAt(filesArray[z].pieces, i->expr)));
+	// objects hold the same scans at relative addresses that the workers make
+	if(programFlags.link){
+		traceBegin("loadObjects", NULL);
+		loadObjects();
+		mergeFiles();
+		traceEnd();
+	// cached files are loaded by the same workers that scan files at relative addresses
+	}else if(programFlags.jobs > 1 || cacheDir){
+		traceBegin("scanFilesParallel", NULL);
+		scanFilesParallel(programFlags.jobs > 1 ? programFlags.jobs : 1);
+		traceEnd();
+	}else{
+		for(int a = 0; a < fssize; ++a){
+			beginPlacement();
+			traceBegin("createPieces", filesArray[a].name);
+			createPieces(filesArray + a);
+			traceEnd();
+			traceBegin("scanPieces", filesArray[a].name);
+			int errorLine = scanPieces(filesArray + a);
+			traceEnd();
+			if(errorLine){
+				addErrorMessage("from file \"%s\" on line %d", filesArray[a].name, errorLine);
 				printErrorsExit();
 			}
-			i->value = v - i->value; // special for branch instructions
-			if(i->size >= 2){
-				memImage[i->offset + 1] = i->value;
-			}
-			if(i->size == 3){
-				memImage[i->offset + 2] = i->value >> 8;
-			}
+			endPlacement(filesArray + a);
 		}
 	}
 
-
-	testError(!startLabel, "no start label");
-	testError(!intLabel, "no interrupt label");
-	printf("START ADDR: %.4X INTERRUPT ADDR: %.4X\n", startLabel->value, intLabel->value);
-	memImage[0x7FFC] = startLabel->value;
-	memImage[0x7FFD] = startLabel->value >> 8;
-	memImage[0x7FFE] = intLabel->value;
-	memImage[0x7FFF] = intLabel->value >> 8;
-
-	// do set commands last over everything
-	for(int* p = listBeg(setCommands); p != listEnd(setCommands); p += 2){
-		memImage[p[0] % 0x8000] = p[1];
+	int start, interrupt;
+	linkFiles(&start, &interrupt);
+	printf("START ADDR: %.4X INTERRUPT ADDR: %.4X\n", start, interrupt);
+	if(optimizeCode){
+		printOptimizations();
+	}
+	if(programFlags.cycles){
+		printCycles();
 	}
-	listZero(&setCommands);
 
 	// write final output
-	FILE* f = fopen(outputName, "wb");
-	testError(!f, "%s fopen: %s", __func__, strerror(errno));
-	testError(fwrite(memImage, 1, EEPROM_IMAGE_SIZE, f) != EEPROM_IMAGE_SIZE, "out file write failure");
-	testError(fclose(f), "%s fclose: %s", __func__, strerror(errno));
+	traceBegin("writeImage", NULL);
+	writeImage(outputName);
+	traceEnd();
 
 	if(programFlags.verbose){
 		printVerbose();
 	}
 
+	if(programFlags.stats){
+		printStats();
+	}
+
 	if(programFlags.list){
-		for(size_t idx = 0; idx < EEPROM_IMAGE_SIZE; ++idx){
-			printf("0x%.2X,", memImage[idx]);
-		}
-		puts("");
+		fflush(stdout);
+		listImage();
+	}
+
+	if(programFlags.run){
+		traceBegin("runImage", NULL);
+		runImage(runCycles, foldedName);
+		traceEnd();
 	}
 
 	return EXIT_SUCCESS;
@@ -197,10 +154,36 @@ int main(int argc, char* argv[]){
 
 
 
+// scan each file and write it as an object file named by -o, or by the file name with its extension replaced by .o
+static void compileObjects(void){
+	testError(outputGiven && fssize > 1, "-o can only name the object file when one file is compiled with -c");
+	traceBegin("scanFiles", NULL);
+	scanFiles(programFlags.jobs > 1 ? programFlags.jobs : 1);
+	traceEnd();
+	for(int fn = 0; fn < fssize; ++fn){
+		char name[4096];
+		if(outputGiven){
+			snprintf(name, sizeof(name), "%s", outputName);
+		}else{
+			const char* source = filesArray[fn].name;
+			const char* base = strrchr(source, '/');
+			const char* dot = strrchr(base ? base : source, '.');
+			int len = dot ? (int)(dot - source) : (int)strlen(source);
+			snprintf(name, sizeof(name), "%.*s.o", len, source);
+		}
+		traceBegin("writeObject", filesArray[fn].name);
+		writeObject(fn, name);
+		traceEnd();
+	}
+	if(programFlags.stats){
+		printStats();
+	}
+}
+
 static void printVerbose(void){
 	/*printf("%zu instructions created\n", instructionList.elementCount);
 	printf("instructions:\nOP   ADDR   VALUE\n");
-	for(struct Instruction* i = listBeg(instructionList); i != listEnd(instructionList); ++i){
+	for(struct Instruction* i = listBeg(&instructionList); i != listEnd(&instructionList); ++i){
 		printf("%.2X   %.4X   ", i->opcode, i->offset);
 		if(i->size == 2){
 			printf("%.2X\n", i->value & 0xFF);
@@ -211,7 +194,7 @@ static void printVerbose(void){
 		}
 	}
 	printf("%zu labels created\nlabels:\nNAME  VALUE\n", labelList.elementCount);
-	for(struct Label* lp = listBeg(labelList); lp != listEnd(labelList); ++lp){
+	for(struct Label* lp = listBeg(&labelList); lp != listEnd(&labelList); ++lp){
 		printf("%s  %X\n", stringAt(lp->name), lp->value);
 	}*/
 }
@@ -223,13 +206,42 @@ static void processArgs(int argc, char* argv[]){
 		"-v / --version, print information about symbols and data\n"
 		"-h / --help, print this info\n"
 		"-o name / --out name, set the name of the output file - default is \"out.mb\"\n"
-		"-l / --list, print a list of comma separated hex values of the code\n";
+		"-l / --list, print a list of comma separated hex values of the code\n"
+		"-j n / --jobs n, lex and scan up to n files at once - default is 1\n"
+		"-O / --optimize, rewrite slow instruction sequences such as jsr then rts, lda #0 then sta, and jmp to a near target, and print each rewrite\n"
+		"--trace name, write a chrome trace of the time each phase takes to file name\n"
+		"--stats, print memory use and counts of work done, needs a build with MBASM_STATS\n"
+		"--cache-dir dir, keep scanned files in dir and load files that did not change from it\n"
+		"--watch, stay running and rebuild the output each time an input file is saved\n"
+		"-c / --compile, write each infile as an object file named by -o or by the infile with its extension replaced by .o\n"
+		"--link, build the output from object files written with -c instead of from source files\n"
+		"--format name, write the output as bin, ihex, srec or carray - default is bin, the others only hold the bytes that were placed\n"
+		"--cycles, print the best and worst case cycles from each code label to the end of its routine and of the interrupt handler\n"
+		"--run n, run the image from the reset vector for up to n cycles or until stp or wai and print the cycles and calls of each code label\n"
+		"--folded name, write the call stacks of --run with the cycles spent in each to file name in the folded format of flame graph tools\n"
+		"--stub spec, make reads of the addresses of spec give a value and drop writes to them during --run, spec is start[-end][=value]\n"
+		"--map name, read the rom and ram segments from file name, each line is: name rom|ram start size [fill]\n"
+		"\tdefault is rom ROM at 0x8000 of 0x8000 bytes and ram RAM at 0x200 up to it, files choose segments with .SEGMENT name\n";
 
 	static struct option longOptions[] = {
 		{.name = "verbose", .has_arg = 0, .flag = NULL, .val = 'v'},
 		{.name = "help", .has_arg = 0, .flag = NULL, .val = 'h'},
 		{.name = "out", .has_arg = 1, .flag = NULL, .val = 'o'},
 		{.name = "list", .has_arg = 0, .flag = NULL, .val = 'l'},
+		{.name = "jobs", .has_arg = 1, .flag = NULL, .val = 'j'},
+		{.name = "optimize", .has_arg = 0, .flag = NULL, .val = 'O'},
+		{.name = "trace", .has_arg = 1, .flag = NULL, .val = 'T'},
+		{.name = "stats", .has_arg = 0, .flag = NULL, .val = 'S'},
+		{.name = "cache-dir", .has_arg = 1, .flag = NULL, .val = 'C'},
+		{.name = "watch", .has_arg = 0, .flag = NULL, .val = 'W'},
+		{.name = "compile", .has_arg = 0, .flag = NULL, .val = 'c'},
+		{.name = "link", .has_arg = 0, .flag = NULL, .val = 'L'},
+		{.name = "format", .has_arg = 1, .flag = NULL, .val = 'F'},
+		{.name = "map", .has_arg = 1, .flag = NULL, .val = 'M'},
+		{.name = "cycles", .has_arg = 0, .flag = NULL, .val = 'Y'},
+		{.name = "run", .has_arg = 1, .flag = NULL, .val = 'R'},
+		{.name = "folded", .has_arg = 1, .flag = NULL, .val = 'P'},
+		{.name = "stub", .has_arg = 1, .flag = NULL, .val = 'U'},
 		{0, 0, 0, 0},
 	};
 	
@@ -241,17 +253,69 @@ static void processArgs(int argc, char* argv[]){
 
 	// go through args
 	int o;
-	while((o = getopt_long(argc, argv, "lvho:", longOptions, NULL)) != -1){
+	while((o = getopt_long(argc, argv, "lvhcOo:j:", longOptions, NULL)) != -1){
 		switch(o){
 			case 'v':
 				programFlags.verbose = true;
 				break;
 			case 'o':
 				outputName = optarg;
+				outputGiven = true;
 				break;
 			case 'l':
 				programFlags.list = true;
 				break;
+			case 'j':
+				programFlags.jobs = atoi(optarg);
+				testError(programFlags.jobs < 1, "jobs must be a positive number: %s", optarg);
+				break;
+			case 'O':
+				optimizeCode = true;
+				break;
+			case 'T':
+				traceOpen(optarg);
+				break;
+			case 'S':
+				testError(!statsAvailable, "--stats needs mbasm built with MBASM_STATS, configure with -DMBASM_STATS=ON");
+				programFlags.stats = true;
+				break;
+			case 'W':
+				programFlags.watch = true;
+				break;
+			case 'c':
+				programFlags.compile = true;
+				break;
+			case 'L':
+				programFlags.link = true;
+				break;
+			case 'Y':
+				programFlags.cycles = true;
+				break;
+			case 'R':{
+				char* end;
+				long long n = strtoll(optarg, &end, 0);
+				testError(*optarg == 0 || *end || n <= 0, "cycles to run must be a positive number: %s", optarg);
+				runCycles = n;
+				programFlags.run = true;
+				break;
+			}
+			case 'P':
+				foldedName = optarg;
+				break;
+			case 'U':
+				testError(!addStub(optarg), "stub must be start[-end][=value] with addresses and a byte value: %s", optarg);
+				break;
+			case 'M':
+				testError(segments.elementCount, "only one memory map can be given");
+				loadMemoryMap(optarg);
+				break;
+			case 'F':
+				testError(!setOutputFormat(optarg), "unknown output format \"%s\", use bin, ihex, srec or carray", optarg);
+				break;
+			case 'C':
+				cacheDir = optarg;
+				testError(mkdir(cacheDir, 0777) && errno != EEXIST, "failed to create cache directory \"%s\": %s", cacheDir, strerror(errno));
+				break;
 			case 'h':
 			default:
 				printf("%s", helpMessage);
@@ -259,6 +323,9 @@ static void processArgs(int argc, char* argv[]){
 		}
 	}
 
+	testError(programFlags.compile + programFlags.link + programFlags.watch > 1, "only one of --compile, --link and --watch can be used at once");
+	testError(foldedName && !programFlags.run, "--folded needs --run");
+
 	// exit if no infiles / only args given
 	if(optind == argc){
 		exit(EXIT_SUCCESS);
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "memmap.h"
+#include "utility.h"
+#include "list.h"
+#include "error.h"
+#include "stringmanip.h"
+
+struct List segments = {.allocStep = 8, .elementSize = sizeof(struct Segment)};
+
+// true while files are scanned at their final address, see beginPlacement
+static _Thread_local bool placing = false;
+
+static void addSegment(const char* name, bool rom, uint32_t start, uint32_t size, uint8_t fill){
+	struct Segment s = {.name = strdup(name), .start = start, .size = size, .next = start, .fill = fill, .rom = rom};
+	testError(!s.name, "segment alloc fail");
+	LIST_ADD(&segments, struct Segment, &s, 1);
+}
+
+// return the segment at index idx, or the first of the kind given by rom if idx is -1
+static struct Segment* segmentOrDefault(int idx, bool rom){
+	if(idx >= 0){
+		return listAt(&segments, idx);
+	}
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		if(s->rom == rom){
+			return s;
+		}
+	}
+	return NULL;
+}
+
+// parse a number of a memory map line the way numbers in sources are, returns -1 if it is not one
+static long mapNumber(const char* s){
+	return *s ? strToInt(s, strlen(s)) : -1;
+}
+
+void loadMemoryMap(const char* name){
+	FILE* f = fopen(name, "r");
+	testError(!f, "failed to open memory map \"%s\": %s", name, strerror(errno));
+	char line[256];
+	int lineNum = 0;
+	while(fgets(line, sizeof(line), f)){
+		++lineNum;
+		char* comment = strchr(line, '#');
+		if(comment){
+			*comment = 0;
+		}
+		for(char* c = line; *c; ++c){
+			*c = toupper((unsigned char)*c);
+		}
+		char* fields[6];
+		int n = 0;
+		for(char* t = strtok(line, " \t\r\n"); t && n < 6; t = strtok(NULL, " \t\r\n")){
+			fields[n++] = t;
+		}
+		if(!n){
+			continue;
+		}
+
+		long start = n >= 3 ? mapNumber(fields[2]) : -1, size = n >= 4 ? mapNumber(fields[3]) : -1, fill = n >= 5 ? mapNumber(fields[4]) : 0;
+		const char* problem = NULL;
+		if(n < 4 || n > 5){
+			problem = "expected: name rom|ram start size [fill]";
+		}else if(strcmp(fields[1], "ROM") && strcmp(fields[1], "RAM")){
+			problem = "segment kind must be rom or ram";
+		}else if(start < 0 || size <= 0 || start + size > ADDRESS_SPACE){
+			problem = "start and size must be numbers that give a range of the 64K address space";
+		}else if(fill < 0 || fill > 0xFF){
+			problem = "fill must be a byte value";
+		}else if(findSegment(fields[0]) >= 0){
+			problem = "segment name is already used";
+		}
+		for(struct Segment* s = listBeg(&segments); !problem && s != listEnd(&segments); ++s){
+			if(start < s->start + s->size && s->start < start + size){
+				problem = "segment overlaps another segment";
+			}
+		}
+		testError(problem, "in memory map \"%s\" on line %d: %s", name, lineNum, problem);
+		addSegment(fields[0], !strcmp(fields[1], "ROM"), start, size, fill);
+	}
+	testError(ferror(f), "failed to read memory map \"%s\"", name);
+	fclose(f);
+	testError(!segmentOrDefault(-1, true), "memory map \"%s\" has no rom segment to place code in", name);
+}
+
+void defaultMemoryMap(void){
+	addSegment("ROM", true, 0x8000, 0x8000, 0);
+	addSegment("RAM", false, 0x200, 0x7E00, 0);
+}
+
+void fillImage(void){
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		if(s->rom){
+			memset(memImage + s->start, s->fill, s->size);
+		}
+	}
+}
+
+int findSegment(const char* name){
+	for(size_t a = 0; a < segments.elementCount; ++a){
+		if(!strcmp(LIST_AT(&segments, struct Segment, a)->name, name)){
+			return a;
+		}
+	}
+	return -1;
+}
+
+struct Segment* romSegmentAt(uint32_t address, uint32_t size){
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		if(s->rom && address >= s->start && address + size <= s->start + s->size){
+			return s;
+		}
+	}
+	return NULL;
+}
+
+struct Segment* fileRomSegment(const struct FileData* f){
+	return segmentOrDefault(f->romSegment, true);
+}
+
+struct Segment* fileRamSegment(const struct FileData* f){
+	return segmentOrDefault(f->ramSegment, false);
+}
+
+void assignSegments(struct FileData* f){
+	for(struct Command* c = listBeg(&f->commands); c != listEnd(&f->commands); ++c){
+		if(c->id != CID_SEGMENT){
+			continue;
+		}
+		int seg = findSegment(stringAt(c->segment.name));
+		testError(seg < 0, "file \"%s\" uses segment \"%s\" which is not in the memory map", f->name, stringAt(c->segment.name));
+		if(LIST_AT(&segments, struct Segment, seg)->rom){
+			f->romSegment = seg;
+		}else{
+			f->ramSegment = seg;
+		}
+	}
+}
+
+void beginPlacement(void){
+	placing = true;
+	memIdx = segmentOrDefault(-1, true)->next;
+}
+
+void endPlacement(struct FileData* f){
+	placing = false;
+	struct Segment* s = fileRomSegment(f);
+	testError(memIdx > s->start + s->size, "file \"%s\" does not fit in segment \"%s\", it needs %.4zX bytes and %.4X are left", f->name, s->name, memIdx - s->next, s->start + s->size - s->next);
+	s->next = memIdx;
+}
+
+void placeInSegment(int seg){
+	if(placing){
+		memIdx = LIST_AT(&segments, struct Segment, seg)->next;
+	}
+}
+
+uint32_t placeFile(struct FileData* f, uint32_t size){
+	struct Segment* s = fileRomSegment(f);
+	testError(s->next + size > s->start + s->size, "file \"%s\" does not fit in segment \"%s\", it needs %.4X bytes and %.4X are left", f->name, s->name, size, s->start + s->size - s->next);
+	uint32_t base = s->next;
+	s->next += size;
+	return base;
+}
@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "object.h"
+#include "list.h"
+#include "error.h"
+#include "utility.h"
+#include "expr.h"
+#include "ins_values.h"
+#include "relax.h"
+
+// bump when anything stored in a scan changes layout or meaning
+#define SCAN_FORMAT 6
+
+// start of every scan file
+struct ScanHeader{
+	char magic[4];		// SCAN_CACHE or SCAN_OBJECT
+	uint32_t format;	// SCAN_FORMAT
+	uint64_t key;		// key given to writeScan
+	uint64_t imageSize;	// bytes of image after the lists
+};
+
+// each list is stored as its element size and count followed by the elements
+struct ScanList{
+	uint32_t elementSize;
+	uint32_t pad;
+	uint64_t count;
+};
+
+// lists of a scan in the order they are stored
+#define SCAN_LISTS(f, chars, s) {chars, &(f)->pieces.types, &(f)->pieces.values, &(f)->labels, &(f)->instructions, &(f)->relocs, &(f)->commands, &(f)->exprs, &(f)->code, &(s)->source, &(s)->exports, &(s)->imports}
+#define SCAN_LIST_COUNT 12
+
+static struct ScanSymbols newScanSymbols(void){
+	struct ScanSymbols s = {
+		.source = listNew(1, 0),
+		.exports = listNew(sizeof(uint32_t), 0),
+		.imports = listNew(sizeof(uint32_t), 0),
+	};
+	return s;
+}
+
+void scanSymbolsZero(struct ScanSymbols* s){
+	listZero(&s->source);
+	listZero(&s->exports);
+	listZero(&s->imports);
+}
+
+// find the labels file f defines and the ones it uses from other files, strings is the number of strings it has
+static struct ScanSymbols findSymbols(const struct FileData* f, size_t strings){
+	struct ScanSymbols s = newScanSymbols();
+	listAdd(&s.source, f->name, strlen(f->name) + 1);
+	// 1 for defined, 2 for imported
+	unsigned char* seen = calloc(strings ? strings : 1, 1);
+	testError(!seen, "symbol list alloc fail");
+	for(const struct Command* c = listBeg(&f->commands); c != listEnd(&f->commands); ++c){
+		uint32_t name;
+		switch(c->id){
+			case CID_CONST:
+				name = c->constant.name;
+				break;
+			case CID_ALLOC:
+				name = c->alloc.name;
+				break;
+			case CID_LABEL:
+				name = c->label.name;
+				break;
+			case CID_STRING:
+				name = c->string.name;
+				break;
+			default:
+				continue;
+		}
+		if(!seen[name]){
+			seen[name] = 1;
+			LIST_ADD(&s.exports, uint32_t, &name, 1);
+		}
+	}
+	for(const struct ExprOp* op = listBeg(&f->code); op != listEnd(&f->code); ++op){
+		if(op->label && !seen[op->name]){
+			seen[op->name] = 2;
+			uint32_t name = op->name;
+			LIST_ADD(&s.imports, uint32_t, &name, 1);
+		}
+	}
+	free(seen);
+	return s;
+}
+
+bool writeScan(const char* name, const char* kind, uint64_t key, const struct FileData* f, const struct StringTable* strings, const unsigned char* image, size_t size){
+	char temp[4096];
+	snprintf(temp, sizeof(temp), "%s.tmpXXXXXX", name);
+	int fd = mkstemp(temp);
+	if(fd < 0){
+		return false;
+	}
+	FILE* out = fdopen(fd, "wb");
+	if(!out){
+		close(fd);
+		unlink(temp);
+		return false;
+	}
+
+	struct ScanSymbols s = findSymbols(f, strings->offsets.elementCount);
+	struct ScanHeader h = {.format = SCAN_FORMAT, .key = key, .imageSize = size};
+	memcpy(h.magic, kind, 4);
+	bool ok = fwrite(&h, sizeof(h), 1, out) == 1;
+	const struct List* lists[SCAN_LIST_COUNT] = SCAN_LISTS(f, &strings->chars, &s);
+	for(int a = 0; ok && a < SCAN_LIST_COUNT; ++a){
+		struct ScanList l = {.elementSize = lists[a]->elementSize, .count = lists[a]->elementCount};
+		// an empty list may have no array at all
+		ok = fwrite(&l, sizeof(l), 1, out) == 1 && (!l.count || fwrite(listBeg(lists[a]), l.elementSize, l.count, out) == l.count);
+	}
+	ok = ok && fwrite(image, 1, size, out) == size;
+	ok = !fclose(out) && ok;
+	scanSymbolsZero(&s);
+	if(!ok || rename(temp, name)){
+		unlink(temp);
+		return false;
+	}
+	return true;
+}
+
+// return the instruction of scan f starting at address offset, NULL if none does, the instructions must be sorted by address
+static const struct Instruction* scanInstructionAt(const struct FileData* f, uint32_t offset){
+	const struct Instruction* i = listBeg(&f->instructions);
+	size_t lo = 0, hi = f->instructions.elementCount;
+	while(lo < hi){
+		size_t mid = (lo + hi) / 2;
+		if(i[mid].offset < offset){
+			lo = mid + 1;
+		}else{
+			hi = mid;
+		}
+	}
+	return lo < f->instructions.elementCount && i[lo].offset == offset ? i + lo : NULL;
+}
+
+// check that every string id, expression handle, command id and list index of scan f stays in range
+// and that everything placed in the image, from its address to the last byte written there, fits in the imageSize bytes of the scan
+// handles of commands and relocations can't be EXPR_NONE, lengths holds the length of each of the strings of the scan
+static bool checkScan(const struct FileData* f, const struct ScanSymbols* s, const size_t* lengths, size_t strings, size_t imageSize){
+	size_t exprs = f->exprs.elementCount;
+	if(f->pieces.types.elementCount != f->pieces.values.elementCount || !exprs){
+		return false;
+	}
+	const uint32_t* values = listBeg(&f->pieces.values);
+	for(size_t p = 0; p < f->pieces.types.elementCount; ++p){
+		if(pieceType(f, p) == PT_STRING && values[p] >= strings){
+			return false;
+		}
+	}
+	for(const struct Label* l = listBeg(&f->labels); l != listEnd(&f->labels); ++l){
+		if(l->name >= strings){
+			return false;
+		}
+	}
+	// instructions are looked up by address, so they must be in order
+	for(const struct Instruction* i = listBeg(&f->instructions); i != listEnd(&f->instructions); ++i){
+		if(i->expr >= exprs || i->mode >= AM_NULL || i->size > 3 || i->offset + i->size > imageSize || (i != listBeg(&f->instructions) && i->offset < i[-1].offset)){
+			return false;
+		}
+	}
+	for(const struct Reloc* r = listBeg(&f->relocs); r != listEnd(&f->relocs); ++r){
+		if(r->expr == EXPR_NONE || r->expr >= exprs || r->kind > RK_ADDRESS || r->offset + (r->kind == RK_WORD || r->kind == RK_ADDRESS ? 2 : 1) > imageSize){
+			return false;
+		}
+		// an address that can shrink to zero page is the value of an absolute instruction that has a zero page form
+		const struct Instruction* i = r->offset ? scanInstructionAt(f, r->offset - 1) : NULL;
+		if(r->kind == RK_ADDRESS && (!i || i->size != 3 || zeroPageMode(i->mode) == AM_NULL)){
+			return false;
+		}
+	}
+	for(const struct Command* c = listBeg(&f->commands); c != listEnd(&f->commands); ++c){
+		// string ids and expression handles of the command
+		uint32_t names[2] = {0}, handles[3] = {0};
+		int nameCount = 0, handleCount = 0;
+		// address of the command in the image and the bytes it writes there
+		uint32_t at = 0, bytes = 0;
+		switch(c->id){
+			case CID_DROP:
+				handles[handleCount++] = c->drop.expr;
+				at = c->drop.offset;
+				bytes = 1;
+				break;
+			case CID_DROP16:
+				handles[handleCount++] = c->drop16.expr;
+				at = c->drop16.offset;
+				bytes = 2;
+				break;
+			case CID_CONST:
+				names[nameCount++] = c->constant.name;
+				handles[handleCount++] = c->constant.expr;
+				break;
+			case CID_ALLOC:
+				names[nameCount++] = c->alloc.name;
+				handles[handleCount++] = c->alloc.expr;
+				break;
+			case CID_SET:
+				handles[handleCount++] = c->set.addr;
+				handles[handleCount++] = c->set.value;
+				break;
+			case CID_LABEL:
+				names[nameCount++] = c->label.name;
+				at = c->label.addr;
+				break;
+			case CID_STRING:
+				names[nameCount++] = c->string.name;
+				names[nameCount++] = c->string.value;
+				at = c->string.offset;
+				// the string is written with its nul
+				bytes = c->string.value < strings ? lengths[c->string.value] + 1 : 0;
+				break;
+			case CID_SEGMENT:
+				names[nameCount++] = c->segment.name;
+				break;
+			case CID_CYCLES:
+				handles[handleCount++] = c->cycles.from;
+				handles[handleCount++] = c->cycles.to;
+				handles[handleCount++] = c->cycles.max;
+				break;
+			default:
+				return false;
+		}
+		if(at > imageSize || bytes > imageSize - at){
+			return false;
+		}
+		for(int a = 0; a < nameCount; ++a){
+			if(names[a] >= strings){
+				return false;
+			}
+		}
+		for(int a = 0; a < handleCount; ++a){
+			if(handles[a] == EXPR_NONE || handles[a] >= exprs){
+				return false;
+			}
+		}
+	}
+	// handle 0 is EXPR_NONE and has no source piece
+	for(const struct Expr* e = listBeg(&f->exprs); e != listEnd(&f->exprs); ++e){
+		if(e->code > f->code.elementCount || e->len > f->code.elementCount - e->code || (e != listBeg(&f->exprs) && e->piece >= f->pieces.types.elementCount)){
+			return false;
+		}
+	}
+	for(const struct ExprOp* op = listBeg(&f->code); op != listEnd(&f->code); ++op){
+		// a bool holding anything but 0 or 1 can't be read as one
+		if(*(const unsigned char*)&op->label > 1 || (op->label && op->name >= strings)){
+			return false;
+		}
+	}
+	const struct List* symbols[] = {&s->exports, &s->imports};
+	for(int a = 0; a < 2; ++a){
+		for(const uint32_t* n = listBeg(symbols[a]); n != listEnd(symbols[a]); ++n){
+			if(*n >= strings){
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool readScan(const char* name, const char* kind, uint64_t key, struct FileData* f, unsigned char* image, size_t* size, struct ScanSymbols* symbols){
+	int fd = open(name, O_RDONLY);
+	if(fd < 0){
+		return false;
+	}
+	struct stat st;
+	const unsigned char* data = MAP_FAILED;
+	if(!fstat(fd, &st) && st.st_size >= (off_t)sizeof(struct ScanHeader)){
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if(data == MAP_FAILED){
+		return false;
+	}
+
+	// check the whole scan before anything is loaded, lists are not aligned so they are copied out
+	struct ScanHeader h;
+	memcpy(&h, data, sizeof(h));
+	struct List chars = listNew(1, 0);
+	struct ScanSymbols s = newScanSymbols();
+	struct List* lists[SCAN_LIST_COUNT] = SCAN_LISTS(f, &chars, &s);
+	size_t offsets[SCAN_LIST_COUNT], counts[SCAN_LIST_COUNT];
+	size_t pos = sizeof(h);
+	bool ok = !memcmp(h.magic, kind, 4) && h.format == SCAN_FORMAT && h.key == key;
+	for(int a = 0; ok && a < SCAN_LIST_COUNT; ++a){
+		struct ScanList l;
+		ok = pos + sizeof(l) <= (size_t)st.st_size;
+		if(ok){
+			memcpy(&l, data + pos, sizeof(l));
+			pos += sizeof(l);
+			ok = l.elementSize == lists[a]->elementSize && l.count <= (st.st_size - pos) / l.elementSize;
+			offsets[a] = pos;
+			counts[a] = l.count;
+			pos += l.count * l.elementSize;
+		}
+	}
+	ok = ok && h.imageSize <= ADDRESS_SPACE && pos + h.imageSize == (size_t)st.st_size;
+	// the strings and the source name must end in a nul
+	ok = ok && (!counts[0] || !data[offsets[0] + counts[0] - 1]) && counts[9] && !data[offsets[9] + counts[9] - 1];
+	if(!ok){
+		munmap((void*)data, st.st_size);
+		return false;
+	}
+
+	for(int a = 0; a < SCAN_LIST_COUNT; ++a){
+		lists[a]->elementCount = 0;
+		if(counts[a]){
+			listAdd(lists[a], data + offsets[a], counts[a]);
+		}
+	}
+	// ids and handles are checked once the lists are aligned, a file that fails is left as newFileData made it
+	struct List lengths = listNew(sizeof(size_t), 64);
+	for(const char* c = listBeg(&chars); c != listEnd(&chars); c += strlen(c) + 1){
+		size_t len = strlen(c);
+		LIST_ADD(&lengths, size_t, &len, 1);
+	}
+	bool good = checkScan(f, &s, listBeg(&lengths), lengths.elementCount, h.imageSize);
+	listZero(&lengths);
+	if(!good){
+		for(int a = 0; a < SCAN_LIST_COUNT; ++a){
+			lists[a]->elementCount = 0;
+		}
+		LIST_ADD(&f->exprs, struct Expr, &((struct Expr){0}), 1);
+		listZero(&chars);
+		scanSymbolsZero(&s);
+		munmap((void*)data, st.st_size);
+		return false;
+	}
+	// adding the strings in order gives them the ids they were scanned with
+	for(char* c = listBeg(&chars); c != listEnd(&chars); c += strlen(c) + 1){
+		addString(c, strlen(c));
+	}
+	listZero(&chars);
+	memcpy(image, data + pos, h.imageSize);
+	*size = h.imageSize;
+	munmap((void*)data, st.st_size);
+	if(symbols){
+		*symbols = s;
+	}else{
+		scanSymbolsZero(&s);
+	}
+	return true;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "output.h"
+#include "link.h"
+#include "list.h"
+#include "error.h"
+#include "utility.h"
+#include "memmap.h"
+
+// bytes collected before they are written to the file
+#define WRITER_SIZE (1 << 16)
+// most bytes a format adds for one record or line
+#define RECORD_MAX 128
+// data bytes in one hex record or c array line
+#define RECORD_BYTES 16
+
+// all formats write through one buffer so the file sees a few large writes
+struct Writer{
+	FILE* file;
+	const char* name;
+	size_t len;
+	char buf[WRITER_SIZE];
+};
+
+// two hex digits for every byte value
+#define HEX_DIGIT(d) ((d) < 10 ? '0' + (d) : 'A' + (d) - 10)
+#define HEX_PAIR(n) {HEX_DIGIT((n) >> 4), HEX_DIGIT((n) & 15)}
+#define HEX_PAIR4(n) HEX_PAIR(n), HEX_PAIR((n) + 1), HEX_PAIR((n) + 2), HEX_PAIR((n) + 3)
+#define HEX_PAIR16(n) HEX_PAIR4(n), HEX_PAIR4((n) + 4), HEX_PAIR4((n) + 8), HEX_PAIR4((n) + 12)
+#define HEX_PAIR64(n) HEX_PAIR16(n), HEX_PAIR16((n) + 16), HEX_PAIR16((n) + 32), HEX_PAIR16((n) + 48)
+static const char hexPairs[256][2] = {HEX_PAIR64(0), HEX_PAIR64(64), HEX_PAIR64(128), HEX_PAIR64(192)};
+
+enum OutputFormat outputFormat = OF_BIN;
+
+static void flushWriter(struct Writer* w){
+	testError(fwrite(w->buf, 1, w->len, w->file) != w->len, "failed to write \"%s\": %s", w->name, strerror(errno));
+	w->len = 0;
+}
+
+// return where the next n bytes go, n is at most RECORD_MAX
+// the caller sets len to the end of what it wrote
+static char* reserve(struct Writer* w, size_t n){
+	if(w->len + n > WRITER_SIZE){
+		flushWriter(w);
+	}
+	return w->buf + w->len;
+}
+
+static inline char* putHex(char* p, uint8_t v){
+	memcpy(p, hexPairs[v], 2);
+	return p + 2;
+}
+
+static void putString(struct Writer* w, const char* s){
+	size_t n = strlen(s);
+	memcpy(reserve(w, n), s, n);
+	w->len += n;
+}
+
+static void writeBin(struct Writer* w){
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		if(!s->rom || !s->used){
+			continue;
+		}
+		for(uint32_t a = s->start; a < s->start + s->size; a += RECORD_MAX){
+			size_t n = s->start + s->size - a < RECORD_MAX ? s->start + s->size - a : RECORD_MAX;
+			memcpy(reserve(w, n), memImage + a, n);
+			w->len += n;
+		}
+	}
+}
+
+// :LLAAAATT, n data bytes, then the two's complement of the sum of all bytes of the record
+static void ihexRecord(struct Writer* w, uint8_t type, uint16_t address, const unsigned char* data, size_t n){
+	char* p = reserve(w, RECORD_MAX);
+	*p++ = ':';
+	uint8_t sum = n + (address >> 8) + address + type;
+	p = putHex(p, n);
+	p = putHex(p, address >> 8);
+	p = putHex(p, address);
+	p = putHex(p, type);
+	for(size_t a = 0; a < n; ++a){
+		sum += data[a];
+		p = putHex(p, data[a]);
+	}
+	p = putHex(p, -sum);
+	*p++ = '\n';
+	w->len = p - w->buf;
+}
+
+static void writeIhex(struct Writer* w){
+	for(struct ImageRange* r = listBeg(&imageRanges); r != listEnd(&imageRanges); ++r){
+		for(uint32_t a = r->start; a < r->end; a += RECORD_BYTES){
+			ihexRecord(w, 0x00, r->offset + a - r->start, memImage + a, r->end - a < RECORD_BYTES ? r->end - a : RECORD_BYTES);
+		}
+	}
+	ihexRecord(w, 0x01, 0, NULL, 0);
+}
+
+// Stype, count of the bytes after it, 16 bit address, n data bytes, then the one's complement of the sum of the bytes after the type
+static void srecRecord(struct Writer* w, char type, uint16_t address, const unsigned char* data, size_t n){
+	char* p = reserve(w, RECORD_MAX);
+	*p++ = 'S';
+	*p++ = type;
+	uint8_t sum = (n + 3) + (address >> 8) + address;
+	p = putHex(p, n + 3);
+	p = putHex(p, address >> 8);
+	p = putHex(p, address);
+	for(size_t a = 0; a < n; ++a){
+		sum += data[a];
+		p = putHex(p, data[a]);
+	}
+	p = putHex(p, ~sum);
+	*p++ = '\n';
+	w->len = p - w->buf;
+}
+
+static void writeSrec(struct Writer* w){
+	srecRecord(w, '0', 0, (const unsigned char*)"mbasm", 5);
+	uint16_t records = 0;
+	for(struct ImageRange* r = listBeg(&imageRanges); r != listEnd(&imageRanges); ++r){
+		for(uint32_t a = r->start; a < r->end; a += RECORD_BYTES, ++records){
+			srecRecord(w, '1', r->offset + a - r->start, memImage + a, r->end - a < RECORD_BYTES ? r->end - a : RECORD_BYTES);
+		}
+	}
+	srecRecord(w, '5', records, NULL, 0);
+	srecRecord(w, '9', 0, NULL, 0);
+}
+
+// an array image_OOOO for each range at offset OOOO, then the offset and length of every range and pointers to their arrays
+static void writeCarray(struct Writer* w){
+	char line[RECORD_MAX];
+	putString(w, "// image written by mbasm, offsets are where the bytes are in the bin output\n");
+	for(struct ImageRange* r = listBeg(&imageRanges); r != listEnd(&imageRanges); ++r){
+		snprintf(line, sizeof(line), "const unsigned char image_%.4X[0x%.4X] = {\n", r->offset, r->end - r->start);
+		putString(w, line);
+		for(uint32_t a = r->start; a < r->end; a += RECORD_BYTES){
+			char* p = reserve(w, RECORD_MAX);
+			*p++ = '\t';
+			for(uint32_t b = a; b < r->end && b < a + RECORD_BYTES; ++b){
+				memcpy(p, b == a ? "0x" : " 0x", b == a ? 2 : 3);
+				p += b == a ? 2 : 3;
+				p = putHex(p, memImage[b]);
+				*p++ = ',';
+			}
+			*p++ = '\n';
+			w->len = p - w->buf;
+		}
+		putString(w, "};\n");
+	}
+	snprintf(line, sizeof(line), "const unsigned short image_ranges[%zu][2] = {\n", imageRanges.elementCount);
+	putString(w, line);
+	for(struct ImageRange* r = listBeg(&imageRanges); r != listEnd(&imageRanges); ++r){
+		snprintf(line, sizeof(line), "\t{0x%.4X, 0x%.4X},\n", r->offset, r->end - r->start);
+		putString(w, line);
+	}
+	snprintf(line, sizeof(line), "};\nconst unsigned char* const image_data[%zu] = {\n", imageRanges.elementCount);
+	putString(w, line);
+	for(struct ImageRange* r = listBeg(&imageRanges); r != listEnd(&imageRanges); ++r){
+		snprintf(line, sizeof(line), "\timage_%.4X,\n", r->offset);
+		putString(w, line);
+	}
+	putString(w, "};\n");
+}
+
+static const struct{
+	const char* name;
+	void (*write)(struct Writer* w);
+} formats[] = {
+	[OF_BIN] = {"bin", writeBin},
+	[OF_IHEX] = {"ihex", writeIhex},
+	[OF_SREC] = {"srec", writeSrec},
+	[OF_CARRAY] = {"carray", writeCarray},
+};
+
+bool setOutputFormat(const char* name){
+	for(size_t a = 0; a < sizeof(formats) / sizeof(*formats); ++a){
+		if(!strcmp(name, formats[a].name)){
+			outputFormat = a;
+			return true;
+		}
+	}
+	return false;
+}
+
+void writeImage(const char* name){
+	static struct Writer w;
+	w.file = fopen(name, "wb");
+	w.name = name;
+	w.len = 0;
+	testError(!w.file, "%s fopen: %s", __func__, strerror(errno));
+	formats[outputFormat].write(&w);
+	flushWriter(&w);
+	testError(fclose(w.file), "%s fclose: %s", __func__, strerror(errno));
+}
+
+void listImage(void){
+	static struct Writer w;
+	w.file = stdout;
+	w.name = "stdout";
+	w.len = 0;
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		for(uint32_t a = s->start; s->rom && s->used && a < s->start + s->size; ++a){
+			char* p = reserve(&w, 5);
+			*p++ = '0';
+			*p++ = 'x';
+			p = putHex(p, memImage[a]);
+			*p++ = ',';
+			w.len = p - w.buf;
+		}
+	}
+	putString(&w, "\n");
+	flushWriter(&w);
+}
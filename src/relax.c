@@ -0,0 +1,703 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "relax.h"
+#include "types.h"
+#include "utility.h"
+#include "list.h"
+#include "error.h"
+#include "expr.h"
+#include "symbols.h"
+#include "commandeval.h"
+#include "link.h"
+#include "memmap.h"
+
+// a change of size in the image, the bytes from address at on in its segment move by delta
+// a negative delta removes the -delta bytes before at, a positive one makes room for delta bytes before at
+struct Resize{
+	uint32_t at;
+	int32_t delta;
+};
+
+// resizes sorted by address and the sum of the deltas before each one
+struct Moves{
+	const struct Resize* r;
+	int32_t* sums;	// sums[n] is the sum of the deltas of r[0] to r[n - 1]
+	size_t n;
+};
+
+// a branch whose target is out of reach, rewritten to its long form once the code after it moved to make room
+struct Growth{
+	int file;		// index into filesArray
+	uint32_t offset;	// address of the branch before the move
+	int target;		// target of a branch with a known value
+};
+
+// growths found in the current pass of sizeInstructions
+static struct List growths = {.allocStep = 64, .elementSize = sizeof(struct Growth)};
+
+// a zero page instruction shrunk in an earlier pass whose value left zero page, rewritten to its absolute form once the code after it moved
+struct Widening{
+	int file;		// index into filesArray
+	uint32_t offset;	// address of the instruction before the move
+};
+
+// widenings found in the current pass of sizeInstructions
+static struct List widenings = {.allocStep = 16, .elementSize = sizeof(struct Widening)};
+
+// commands of each file as they were scanned, NULL if no instruction can change size
+static struct List* keptCommands;
+
+bool optimizeCode = false;
+
+// rewrites optimizeInstructions makes
+enum Peephole{
+	PH_TAIL_CALL,		// jsr x, rts -> jmp x
+	PH_BRANCH_TO_JMP,	// branch to a jmp x -> branch to x
+	PH_STORE_ZERO,		// lda #0, sta ... -> stz ...
+	PH_CARRY,		// clc or sec right before another one is removed
+	PH_JMP_TO_BRA,		// jmp x -> bra x
+	PH_NULL
+};
+
+static const char* peepholeNames[] = {
+	[PH_TAIL_CALL] = "jsr, rts to jmp",
+	[PH_BRANCH_TO_JMP] = "branch to jmp",
+	[PH_STORE_ZERO] = "lda #0, sta to stz",
+	[PH_CARRY] = "dead clc/sec",
+	[PH_JMP_TO_BRA] = "jmp to bra",
+};
+
+// bytes and cycles each rewrite saves, a branch to a jmp saves the jmp when it is taken
+static const struct{
+	int bytes;
+	int cycles;
+} peepholeSavings[] = {
+	[PH_TAIL_CALL] = {1, 9},
+	[PH_BRANCH_TO_JMP] = {0, 3},
+	[PH_STORE_ZERO] = {2, 2},
+	[PH_CARRY] = {1, 2},
+	[PH_JMP_TO_BRA] = {1, 0},
+};
+
+static struct{
+	int count;
+	int bytes;
+	int cycles;
+} peepholes[PH_NULL];
+
+enum AddressingMode zeroPageMode(enum AddressingMode mode){
+	switch(mode){
+		case AM_ABS:
+			return AM_ZP;
+		case AM_ABSX:
+			return AM_ZPX;
+		case AM_ABSY:
+			return AM_ZPY;
+		default:
+			return AM_NULL;
+	}
+}
+
+void keepCommands(void){
+	bool any = false;
+	for(int z = 0; z < fssize && !any; ++z){
+		for(struct Reloc* r = listBeg(&filesArray[z].relocs); r != listEnd(&filesArray[z].relocs) && !any; ++r){
+			any = r->kind == RK_ADDRESS;
+		}
+		// any branch can turn out to be out of reach
+		for(struct Instruction* i = listBeg(&filesArray[z].instructions); i != listEnd(&filesArray[z].instructions) && !any; ++i){
+			any = i->mode == AM_PCR;
+		}
+	}
+	if(!any && !optimizeCode){
+		return;
+	}
+	testError((keptCommands = malloc(sizeof(struct List) * fssize)) == NULL, "command copy alloc fail");
+	for(int z = 0; z < fssize; ++z){
+		keptCommands[z] = listNew(sizeof(struct Command), 0);
+		listAdd(keptCommands + z, listBeg(&filesArray[z].commands), filesArray[z].commands.elementCount);
+	}
+}
+
+// return the number of resizes before address x
+static size_t resizesBefore(const struct Moves* m, uint32_t x){
+	size_t lo = 0, hi = m->n;
+	while(lo < hi){
+		size_t mid = (lo + hi) / 2;
+		if(m->r[mid].at < x){
+			lo = mid + 1;
+		}else{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+// return where address x of segment s is after the moves
+static uint32_t moved(const struct Moves* m, const struct Segment* s, uint32_t x){
+	return x + m->sums[resizesBefore(m, x + 1)] - m->sums[resizesBefore(m, s->start)];
+}
+
+// return the opcode of the zero page form of the instruction with opcode and absolute mode
+// opcode is returned as it is if mode has no zero page form
+static uint8_t zeroPageOpcode(uint8_t opcode, enum AddressingMode mode){
+	if(zeroPageMode(mode) == AM_NULL){
+		return opcode;
+	}
+	for(int n = 0; n < IN_NULL; ++n){
+		if(opcodes[n][mode] == opcode + 1){
+			return opcodes[n][zeroPageMode(mode)] - 1;
+		}
+	}
+	return opcode;
+}
+
+// return the absolute mode whose zero page form is mode
+static enum AddressingMode absoluteMode(enum AddressingMode mode){
+	switch(mode){
+		case AM_ZP:
+			return AM_ABS;
+		case AM_ZPX:
+			return AM_ABSX;
+		case AM_ZPY:
+			return AM_ABSY;
+		default:
+			return AM_NULL;
+	}
+}
+
+// return the opcode of the absolute form of the instruction with opcode and zero page mode, the reverse of zeroPageOpcode
+static uint8_t absoluteOpcode(uint8_t opcode, enum AddressingMode mode){
+	if(absoluteMode(mode) == AM_NULL){
+		return opcode;
+	}
+	for(int n = 0; n < IN_NULL; ++n){
+		if(opcodes[n][mode] == opcode + 1){
+			return opcodes[n][absoluteMode(mode)] - 1;
+		}
+	}
+	return opcode;
+}
+
+// return the instruction of file f starting at address offset
+static struct Instruction* instructionAt(struct FileData* f, uint32_t offset){
+	struct Instruction* i = listBeg(&f->instructions);
+	size_t lo = 0, hi = f->instructions.elementCount;
+	while(lo < hi){
+		size_t mid = (lo + hi) / 2;
+		if(i[mid].offset < offset){
+			lo = mid + 1;
+		}else{
+			hi = mid;
+		}
+	}
+	return i + lo;
+}
+
+// return the reloc of file f placing the value at address offset, NULL if it has none
+static struct Reloc* relocAt(struct FileData* f, uint32_t offset){
+	struct Reloc* r = listBeg(&f->relocs);
+	size_t lo = 0, hi = f->relocs.elementCount;
+	while(lo < hi){
+		size_t mid = (lo + hi) / 2;
+		if(r[mid].offset < offset){
+			lo = mid + 1;
+		}else{
+			hi = mid;
+		}
+	}
+	return lo < f->relocs.elementCount && r[lo].offset == offset ? r + lo : NULL;
+}
+
+// set target to the address instruction i of file f goes to, i has an absolute or relative value
+static bool instructionTarget(struct FileData* f, struct Instruction* i, int* target){
+	if(i->expr == EXPR_NONE){
+		*target = i->mode == AM_PCR ? i->offset + 2 + i->value : i->value;
+		return true;
+	}
+	if(!evalExpression(f, i->expr, target)){
+		clearErrors();
+		return false;
+	}
+	return true;
+}
+
+// change every absolute instruction whose value is in zero page to its zero page form and add the byte it frees to resizes
+// one shrunk in an earlier pass whose value left zero page since, such as after a branch grew, is added to widenings with the byte it takes
+// a widened instruction stays absolute, so each instruction shrinks and widens at most once
+static void findShrinks(struct List* resizes){
+	for(int z = 0; z < fssize; ++z){
+		struct FileData* f = filesArray + z;
+		for(struct Reloc* r = listBeg(&f->relocs); r != listEnd(&f->relocs); ++r){
+			int v;
+			if(r->kind != RK_ADDRESS && r->kind != RK_SHRUNK){
+				continue;
+			}
+			// values that can't be evaluated are reported by fixupInstructions
+			if(!evalExpression(f, r->expr, &v)){
+				clearErrors();
+				continue;
+			}
+			bool zeroPage = v >= 0 && v <= 0xFF;
+			if(r->kind == RK_SHRUNK && !zeroPage){
+				struct Widening w = {.file = z, .offset = r->offset - 1};
+				listAdd(&widenings, &w, 1);
+				struct Resize s = {.at = r->offset + 1, .delta = 1};
+				listAdd(resizes, &s, 1);
+				continue;
+			}
+			if(r->kind == RK_SHRUNK || !zeroPage){
+				continue;
+			}
+			struct Instruction* i = instructionAt(f, r->offset - 1);
+			i->opcode = zeroPageOpcode(i->opcode, i->mode);
+			i->mode = zeroPageMode(i->mode);
+			i->size = 2;
+			memImage[i->offset] = i->opcode;
+			r->kind = RK_SHRUNK;
+			struct Resize s = {.at = r->offset + 2, .delta = -1};
+			listAdd(resizes, &s, 1);
+		}
+	}
+}
+
+// rewrite the instructions of widenings to their absolute forms in the room moving the code made, fixupInstructions places their values
+static void widenInstructions(const struct Moves* m){
+	for(struct Widening* w = listBeg(&widenings); w != listEnd(&widenings); ++w){
+		struct FileData* f = filesArray + w->file;
+		uint32_t o = moved(m, fileRomSegment(f), w->offset);
+		struct Instruction* i = instructionAt(f, o);
+		i->opcode = absoluteOpcode(i->opcode, i->mode);
+		i->mode = absoluteMode(i->mode);
+		i->size = 3;
+		memImage[o] = i->opcode;
+		relocAt(f, o + 1)->kind = RK_WORD;
+	}
+}
+
+// return the opcode of the branch taken when branch opcode is not, BRA has none
+static uint8_t invertBranch(uint8_t opcode){
+	// BPL BMI BVC BVS BCC BCS BNE BEQ pair up in bit 5, BBR and BBS in bit 7
+	return (opcode & 0x1F) == 0x10 ? opcode ^ 0x20 : opcode ^ 0x80;
+}
+
+// add a growth for every branch whose target is out of reach and the room its long form takes to resizes
+// bra becomes jmp, other branches become the inverted branch over a jmp
+static void findGrowths(struct List* resizes){
+	for(int z = 0; z < fssize; ++z){
+		struct FileData* f = filesArray + z;
+		for(struct Instruction* i = listBeg(&f->instructions); i != listEnd(&f->instructions); ++i){
+			int target;
+			// targets that can't be evaluated are reported by fixupInstructions
+			if(i->mode != AM_PCR || !instructionTarget(f, i, &target)){
+				continue;
+			}
+			int distance = target - (i->offset + 2);
+			if(distance >= -128 && distance <= 127){
+				continue;
+			}
+			struct Growth g = {.file = z, .offset = i->offset, .target = target};
+			listAdd(&growths, &g, 1);
+			struct Resize s = {.at = i->offset + 2, .delta = i->opcode == OPC_BRA_R ? 1 : 3};
+			listAdd(resizes, &s, 1);
+		}
+	}
+}
+
+static int compareInstructions(const void* a, const void* b){
+	const struct Instruction* ia = a;
+	const struct Instruction* ib = b;
+	return (ia->offset > ib->offset) - (ia->offset < ib->offset);
+}
+
+// rewrite the branches of growths to their long forms in the room moving the code made
+static void growBranches(const struct Moves* m){
+	for(struct Growth* g = listBeg(&growths); g != listEnd(&growths); ++g){
+		struct FileData* f = filesArray + g->file;
+		uint32_t o = moved(m, fileRomSegment(f), g->offset);
+		struct Instruction* i = instructionAt(f, o);
+		struct Reloc* r = i->expr == EXPR_NONE ? NULL : relocAt(f, o + 1);
+		struct Instruction jump = {.value = g->target, .expr = i->expr, .offset = o, .size = 3, .opcode = OPC_JMP_ABS, .mode = AM_ABS};
+		if(i->opcode == OPC_BRA_R){
+			*i = jump;
+		}else{
+			// the inverted branch skips the jmp
+			i->opcode = invertBranch(i->opcode);
+			i->expr = EXPR_NONE;
+			i->value = 3;
+			memImage[o] = i->opcode;
+			memImage[o + 1] = i->value;
+			jump.offset = o + 2;
+			listAdd(&f->instructions, &jump, 1);
+		}
+		memImage[jump.offset] = OPC_JMP_ABS;
+		memImage[jump.offset + 1] = g->target;
+		memImage[jump.offset + 2] = g->target >> 8;
+		if(r){
+			r->offset = jump.offset + 1;
+			r->kind = RK_WORD;
+		}
+	}
+	// added jmps go after their branches, growths are in file order so each file is sorted once
+	for(struct Growth* g = listBeg(&growths); g != listEnd(&growths); ++g){
+		if(g + 1 == listEnd(&growths) || g[1].file != g->file){
+			struct FileData* f = filesArray + g->file;
+			qsort(listBeg(&f->instructions), f->instructions.elementCount, sizeof(struct Instruction), compareInstructions);
+		}
+	}
+}
+
+static int compareResizes(const void* a, const void* b){
+	const struct Resize* ra = a;
+	const struct Resize* rb = b;
+	return (ra->at > rb->at) - (ra->at < rb->at);
+}
+
+// move the bytes of rom segment s, room made for inserted bytes is filled with its fill value
+static void moveSegment(const struct Moves* m, struct Segment* s){
+	size_t first = resizesBefore(m, s->start), last = resizesBefore(m, s->next + 1);
+	if(first == last){
+		return;
+	}
+	uint32_t next = s->next + m->sums[last] - m->sums[first];
+	testError(next > s->start + s->size, "code of segment \"%s\" does not fit in it after resizing instructions", s->name);
+	size_t size = s->next - s->start;
+	unsigned char* old = malloc(size ? size : 1);
+	testError(!old, "segment copy alloc fail");
+	memcpy(old, memImage + s->start, size);
+
+	uint32_t pos = s->start;
+	size_t e = first;
+	for(uint32_t x = s->start; x <= s->next; ++x){
+		for(; e < last && m->r[e].at <= x; ++e){
+			if(m->r[e].delta > 0){
+				memset(memImage + pos, s->fill, m->r[e].delta);
+				pos += m->r[e].delta;
+			}
+		}
+		// bytes before the next resize that removes them are skipped
+		if(x == s->next || (e < last && m->r[e].delta < 0 && x >= m->r[e].at + m->r[e].delta)){
+			continue;
+		}
+		memImage[pos++] = old[x - s->start];
+	}
+	if(pos < s->next){
+		memset(memImage + pos, s->fill, s->next - pos);
+	}
+	s->next = pos;
+	free(old);
+}
+
+// move the addresses of everything file z placed, kept is its copy of the scanned commands
+static void moveFile(const struct Moves* m, int z, struct List* kept){
+	struct FileData* f = filesArray + z;
+	struct Segment* s = fileRomSegment(f);
+	for(struct Instruction* i = listBeg(&f->instructions); i != listEnd(&f->instructions); ++i){
+		uint32_t offset = moved(m, s, i->offset);
+		// known branch targets move with the code at them, such as the branch over the jmp of a long branch
+		// the new distance is written by placeBranches once the bytes moved
+		if(i->mode == AM_PCR && i->expr == EXPR_NONE){
+			uint32_t target = i->offset + 2 + i->value;
+			const struct Segment* ts = romSegmentAt(target, 1);
+			i->value = (ts ? moved(m, ts, target) : target) - (offset + 2);
+		}
+		i->offset = offset;
+	}
+	for(struct Reloc* r = listBeg(&f->relocs); r != listEnd(&f->relocs); ++r){
+		r->offset = moved(m, s, r->offset);
+	}
+	for(struct Command* c = listBeg(kept); c != listEnd(kept); ++c){
+		switch(c->id){
+			case CID_DROP:
+				c->drop.offset = moved(m, s, c->drop.offset);
+				break;
+			case CID_DROP16:
+				c->drop16.offset = moved(m, s, c->drop16.offset);
+				break;
+			case CID_LABEL:
+				c->label.addr = moved(m, s, c->label.addr);
+				break;
+			case CID_STRING:
+				c->string.offset = moved(m, s, c->string.offset);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+// write the distances of the branches with known targets of every file, moveFile changes them before the bytes move
+static void placeBranches(void){
+	for(int z = 0; z < fssize; ++z){
+		for(struct Instruction* i = listBeg(&filesArray[z].instructions); i != listEnd(&filesArray[z].instructions); ++i){
+			if(i->mode == AM_PCR && i->expr == EXPR_NONE){
+				memImage[i->offset + 1] = i->value;
+			}
+		}
+	}
+}
+
+// sort resizes and move the code, relocations and label commands of every file for them
+// then evaluate every command again, since labels and the values of commands depend on addresses
+static bool applyResizes(struct List* resizes, struct List* sums){
+	qsort(listBeg(resizes), resizes->elementCount, sizeof(struct Resize), compareResizes);
+	sums->elementCount = 0;
+	int32_t sum = 0;
+	listAdd(sums, &sum, 1);
+	for(struct Resize* r = listBeg(resizes); r != listEnd(resizes); ++r){
+		sum += r->delta;
+		listAdd(sums, &sum, 1);
+	}
+	struct Moves m = {.r = listBeg(resizes), .sums = listBeg(sums), .n = resizes->elementCount};
+
+	// files are moved while their segments still have the old ends
+	for(int z = 0; z < fssize; ++z){
+		moveFile(&m, z, keptCommands + z);
+	}
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		if(s->rom){
+			moveSegment(&m, s);
+		}
+	}
+	placeBranches();
+	if(growths.elementCount){
+		growBranches(&m);
+		growths.elementCount = 0;
+	}
+	if(widenings.elementCount){
+		widenInstructions(&m);
+		widenings.elementCount = 0;
+	}
+
+	clearLabels();
+	setCommands.elementCount = 0;
+	cycleChecks.elementCount = 0;
+	for(int z = 0; z < fssize; ++z){
+		filesArray[z].labels.elementCount = 0;
+		memcpy(listBeg(&filesArray[z].commands), listBeg(keptCommands + z), keptCommands[z].elementCount * sizeof(struct Command));
+	}
+	return resolveCommands() && finalizeLabels();
+}
+
+// return the instruction after i in file f if it follows i directly with nothing between, NULL otherwise
+static struct Instruction* nextInstruction(struct FileData* f, struct Instruction* i){
+	struct Instruction* n = i + 1;
+	while(n != listEnd(&f->instructions) && !n->size){
+		++n;
+	}
+	return n != listEnd(&f->instructions) && n->offset == i->offset + i->size ? n : NULL;
+}
+
+// addresses of the labels of the file findPeepholes works on, in order
+static struct List labelAddrs = {.allocStep = 256, .elementSize = sizeof(uint32_t)};
+
+// return true if a label of the file findPeepholes works on is at address addr
+static bool labelAt(uint32_t addr){
+	uint32_t* a = listBeg(&labelAddrs);
+	size_t lo = 0, hi = labelAddrs.elementCount;
+	while(lo < hi){
+		size_t mid = (lo + hi) / 2;
+		if(a[mid] < addr){
+			lo = mid + 1;
+		}else{
+			hi = mid;
+		}
+	}
+	return lo < labelAddrs.elementCount && a[lo] == addr;
+}
+
+static void countPeephole(enum Peephole p){
+	++peepholes[p].count;
+	peepholes[p].bytes += peepholeSavings[p].bytes;
+	peepholes[p].cycles += peepholeSavings[p].cycles;
+}
+
+// change instruction i in place to opcode
+static void rewriteOpcode(struct Instruction* i, uint8_t opcode){
+	i->opcode = opcode;
+	memImage[i->offset] = opcode;
+}
+
+// remove instruction i, its bytes are freed when resizes are applied
+static void removeInstruction(struct Instruction* i, struct List* resizes){
+	struct Resize s = {.at = i->offset + i->size, .delta = -(int32_t)i->size};
+	listAdd(resizes, &s, 1);
+	i->size = 0;
+}
+
+// lda #0 followed by stores of a to places stz can store to, and an instruction that loads a again
+static bool storeZeros(int z, struct Instruction* i, struct List* resizes){
+	struct FileData* f = filesArray + z;
+	if(i->opcode != OPC_LDA_IM || i->expr != EXPR_NONE || i->value){
+		return false;
+	}
+	int stores = 0;
+	struct Instruction* n = nextInstruction(f, i);
+	for(; n && opcodes[IN_STA][n->mode] == n->opcode + 1 && opcodes[IN_STZ][n->mode] && !labelAt(n->offset); n = nextInstruction(f, n)){
+		++stores;
+	}
+	// the zero in a must not be used after the stores
+	if(!stores || !n || (opcodes[IN_LDA][n->mode] != n->opcode + 1 && n->opcode != OPC_PLA_S && n->opcode != OPC_TXA_I && n->opcode != OPC_TYA_I)){
+		return false;
+	}
+	for(n = nextInstruction(f, i); stores--; n = nextInstruction(f, n)){
+		rewriteOpcode(n, opcodes[IN_STZ][n->mode] - 1);
+	}
+	removeInstruction(i, resizes);
+	countPeephole(PH_STORE_ZERO);
+	return true;
+}
+
+// make branch i go straight to where the jmp it branches to goes, if it is in reach
+static bool skipJump(int z, struct Instruction* i){
+	struct FileData* f = filesArray + z;
+	struct Reloc* r;
+	int target, jumpTarget;
+	if(i->mode != AM_PCR || i->expr == EXPR_NONE || !(r = relocAt(f, i->offset + 1)) || !instructionTarget(f, i, &target)){
+		return false;
+	}
+	struct Instruction* j = instructionAt(f, target);
+	struct Reloc* jr;
+	if(j == listEnd(&f->instructions) || j->offset != target || !j->size || j->opcode != OPC_JMP_ABS || j->expr == EXPR_NONE || !(jr = relocAt(f, j->offset + 1)) || !instructionTarget(f, j, &jumpTarget)){
+		return false;
+	}
+	// sizeInstructions makes the branch long again if code between grows it out of reach
+	int distance = jumpTarget - (i->offset + 2);
+	if(distance < -128 || distance > 127 || romSegmentAt(jumpTarget, 1) != fileRomSegment(f)){
+		return false;
+	}
+	r->expr = jr->expr;
+	i->expr = jr->expr;
+	countPeephole(PH_BRANCH_TO_JMP);
+	return true;
+}
+
+// make jmp i a bra if its target is in reach
+static bool branchAlways(struct FileData* f, struct Instruction* i, struct List* resizes){
+	int target;
+	if(i->opcode != OPC_JMP_ABS || !instructionTarget(f, i, &target)){
+		return false;
+	}
+	// a forward target comes 1 byte closer once the jmp shrinks, sizeInstructions makes it a jmp again if it ends up out of reach
+	if(target - (i->offset + 2) < -128 || target - (i->offset + 3) > 127 || romSegmentAt(target, 1) != fileRomSegment(f)){
+		return false;
+	}
+	if(i->expr == EXPR_NONE){
+		i->value = target - (i->offset + 2);
+		memImage[i->offset + 1] = i->value;
+	}else{
+		relocAt(f, i->offset + 1)->kind = RK_BRANCH;
+	}
+	rewriteOpcode(i, OPC_BRA_R);
+	i->mode = AM_PCR;
+	i->size = 2;
+	struct Resize s = {.at = i->offset + 3, .delta = -1};
+	listAdd(resizes, &s, 1);
+	countPeephole(PH_JMP_TO_BRA);
+	return true;
+}
+
+// apply the peephole rewrites to the instructions of file z and add the bytes they free to resizes
+static void findPeepholes(int z, struct List* resizes){
+	struct FileData* f = filesArray + z;
+	labelAddrs.elementCount = 0;
+	for(struct Command* c = listBeg(keptCommands + z); c != listEnd(keptCommands + z); ++c){
+		if(c->id == CID_LABEL){
+			LIST_ADD(&labelAddrs, uint32_t, &c->label.addr, 1);
+		}
+	}
+	for(struct Instruction* i = listBeg(&f->instructions); i != listEnd(&f->instructions); ++i){
+		if(!i->size){
+			continue;
+		}
+		struct Instruction* n = nextInstruction(f, i);
+		// a carry flag set or cleared again right away is dead
+		if((i->opcode == OPC_CLC_I || i->opcode == OPC_SEC_I) && n && (n->opcode == OPC_CLC_I || n->opcode == OPC_SEC_I)){
+			removeInstruction(i, resizes);
+			countPeephole(PH_CARRY);
+			continue;
+		}
+		if(storeZeros(z, i, resizes) || skipJump(z, i)){
+			continue;
+		}
+		// nothing may jump to the rts, it is removed
+		if(i->opcode == OPC_JSR_ABS && n && n->opcode == OPC_RTS_S && !labelAt(n->offset)){
+			rewriteOpcode(i, OPC_JMP_ABS);
+			removeInstruction(n, resizes);
+			countPeephole(PH_TAIL_CALL);
+		}
+		branchAlways(f, i, resizes);
+	}
+
+	// removed instructions are dropped so the list stays sorted by address without duplicates
+	struct Instruction* out = listBeg(&f->instructions);
+	for(struct Instruction* i = listBeg(&f->instructions); i != listEnd(&f->instructions); ++i){
+		if(i->size){
+			*out++ = *i;
+		}
+	}
+	f->instructions.elementCount = out - (struct Instruction*)listBeg(&f->instructions);
+}
+
+bool optimizeInstructions(void){
+	if(!optimizeCode){
+		return true;
+	}
+	struct List resizes = listNew(sizeof(struct Resize), 64);
+	struct List sums = listNew(sizeof(int32_t), 64);
+	for(int z = 0; z < fssize; ++z){
+		findPeepholes(z, &resizes);
+	}
+	listZero(&labelAddrs);
+	// retargeted branches keep their size, so labels only move if something was removed
+	bool ok = !resizes.elementCount || applyResizes(&resizes, &sums);
+	listZero(&resizes);
+	listZero(&sums);
+	listZero(&growths);
+	return ok;
+}
+
+void printOptimizations(void){
+	int count = 0, bytes = 0, cycles = 0;
+	printf("peephole rewrites:\n");
+	for(int p = 0; p < PH_NULL; ++p){
+		printf("  %-24s %6d  %6d bytes %7d cycles saved\n", peepholeNames[p], peepholes[p].count, peepholes[p].bytes, peepholes[p].cycles);
+		count += peepholes[p].count;
+		bytes += peepholes[p].bytes;
+		cycles += peepholes[p].cycles;
+	}
+	printf("  %-24s %6d  %6d bytes %7d cycles saved\n", "total", count, bytes, cycles);
+}
+
+bool sizeInstructions(void){
+	bool ok = true;
+	if(!keptCommands){
+		return true;
+	}
+	struct List resizes = listNew(sizeof(struct Resize), 64);
+	struct List sums = listNew(sizeof(int32_t), 64);
+	// branches only grow to long forms, and instructions shrink to zero page and widen back at most once each
+	// a growth can push a shrunk value out of zero page, so shrunk values are checked again on every pass
+	// this ends once a pass finds nothing to change
+	while(ok){
+		resizes.elementCount = 0;
+		findShrinks(&resizes);
+		findGrowths(&resizes);
+		if(!resizes.elementCount){
+			break;
+		}
+		ok = applyResizes(&resizes, &sums);
+	}
+
+	for(int z = 0; z < fssize; ++z){
+		listZero(keptCommands + z);
+	}
+	free(keptCommands);
+	keptCommands = NULL;
+	listZero(&resizes);
+	listZero(&sums);
+	listZero(&growths);
+	listZero(&widenings);
+	return ok;
+}
@@ -0,0 +1,655 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "sim.h"
+#include "types.h"
+#include "utility.h"
+#include "list.h"
+#include "error.h"
+#include "ins_values.h"
+#include "stringmanip.h"
+#include "memmap.h"
+
+// processor status flags
+#define F_C 0x01
+#define F_Z 0x02
+#define F_I 0x04
+#define F_D 0x08
+#define F_B 0x10
+#define F_U 0x20
+#define F_V 0x40
+#define F_N 0x80
+
+// kinds of addresses in kinds, stubs are STUB_KIND plus their index
+#define RAM_KIND 0
+#define ROM_KIND 1
+#define STUB_KIND 2
+#define MAX_STUBS (256 - STUB_KIND)
+
+// no label, code before the first label of the image
+#define NO_LABEL -1
+
+// a range of addresses whose reads and writes go to a stub instead of memory
+struct Stub{
+	uint32_t start;
+	uint32_t end;		// last address
+	uint8_t value;		// value every read gives
+	uint64_t reads;
+	uint64_t writes;
+};
+
+// a label of the call stack, the root has no label and its children are the labels code runs at outside of calls
+struct CallNode{
+	int32_t label;		// index into routines, NO_LABEL for the root
+	int32_t parent;		// index into callNodes, -1 for the root
+	uint64_t cycles;	// cycles spent at the label with this call stack
+};
+
+// a call that has not returned yet
+struct Call{
+	int32_t frame;		// call node of the label called
+	int32_t from;		// call node the call was made from, where the return goes back to
+};
+
+// a code label of the image
+struct Routine{
+	uint32_t name;
+	uint32_t addr;
+	uint64_t self;		// cycles spent at it
+	uint64_t total;		// cycles spent at it and in the calls made from it
+	uint64_t calls;
+};
+
+static struct{
+	uint16_t pc;
+	uint8_t a, x, y, s, p;
+	uint64_t cycles;
+	uint64_t instructions;
+} cpu;
+
+// instruction name and addressing mode of every opcode, IN_NULL for opcodes that are not valid
+static struct{
+	uint8_t name;
+	uint8_t mode;
+} decoded[256];
+
+static const uint8_t modeSizes[] = {
+	[AM_ABS] = 3, [AM_ABSII] = 3, [AM_ABSX] = 3, [AM_ABSY] = 3, [AM_ABSI] = 3,
+	[AM_ACC] = 1, [AM_IM] = 2, [AM_I] = 1, [AM_PCR] = 2, [AM_S] = 1,
+	[AM_ZP] = 2, [AM_ZPII] = 2, [AM_ZPX] = 2, [AM_ZPY] = 2, [AM_ZPI] = 2, [AM_ZPIIY] = 2,
+};
+
+static uint8_t mem[ADDRESS_SPACE];
+static uint8_t kinds[ADDRESS_SPACE];
+static struct List stubs = {.allocStep = 8, .elementSize = sizeof(struct Stub)};
+
+static struct List routines = {.allocStep = 64, .elementSize = sizeof(struct Routine)};
+static int32_t* labelAt;	// index into routines of the label each address is at or after, NO_LABEL if none is before it
+static struct List callNodes = {.allocStep = 1024, .elementSize = sizeof(struct CallNode)};
+static struct List callStack = {.allocStep = 64, .elementSize = sizeof(struct Call)};
+static int32_t* childTable;	// open addressing table of call nodes by parent and label, -1 for empty slots
+static size_t childSlots;
+
+bool addStub(const char* spec){
+	char s[64];
+	snprintf(s, sizeof(s), "%s", spec);
+	for(char* c = s; *c; ++c){
+		*c = toupper((unsigned char)*c);
+	}
+	char* value = strchr(s, '=');
+	if(value){
+		*value++ = 0;
+	}
+	char* end = strchr(s, '-');
+	if(end){
+		*end++ = 0;
+	}
+	long start = *s ? strToInt(s, strlen(s)) : -1, last = end ? (*end ? strToInt(end, strlen(end)) : -1) : start, v = value ? (*value ? strToInt(value, strlen(value)) : -1) : 0;
+	if(start < 0 || last < start || last >= ADDRESS_SPACE || v < 0 || v > 0xFF || stubs.elementCount == MAX_STUBS){
+		return false;
+	}
+	struct Stub stub = {.start = start, .end = last, .value = v};
+	LIST_ADD(&stubs, struct Stub, &stub, 1);
+	return true;
+}
+
+static inline uint8_t readByte(uint16_t addr){
+	if(kinds[addr] >= STUB_KIND){
+		struct Stub* s = LIST_AT(&stubs, struct Stub, kinds[addr] - STUB_KIND);
+		++s->reads;
+		return s->value;
+	}
+	return mem[addr];
+}
+
+// writes to rom are dropped like on the hardware
+static inline void writeByte(uint16_t addr, uint8_t v){
+	if(kinds[addr] >= STUB_KIND){
+		++LIST_AT(&stubs, struct Stub, kinds[addr] - STUB_KIND)->writes;
+	}else if(kinds[addr] == RAM_KIND){
+		mem[addr] = v;
+	}
+}
+
+static inline uint16_t readWord(uint16_t addr){
+	return readByte(addr) | readByte(addr + 1) << 8;
+}
+
+// read a pointer from zero page, wrapping around in it
+static inline uint16_t readZeroPageWord(uint8_t addr){
+	return readByte(addr) | readByte((uint8_t)(addr + 1)) << 8;
+}
+
+static inline void push(uint8_t v){
+	writeByte(0x100 | cpu.s--, v);
+}
+
+static inline uint8_t pull(void){
+	return readByte(0x100 | ++cpu.s);
+}
+
+static inline uint8_t setNZ(uint8_t v){
+	cpu.p = (cpu.p & ~(F_N | F_Z)) | (v & F_N) | (v ? 0 : F_Z);
+	return v;
+}
+
+static inline void setFlag(uint8_t flag, bool on){
+	cpu.p = on ? cpu.p | flag : cpu.p & ~flag;
+}
+
+static void adc(uint8_t v){
+	unsigned c = cpu.p & F_C;
+	unsigned bin = cpu.a + v + c;
+	setFlag(F_V, ~(cpu.a ^ v) & (cpu.a ^ bin) & 0x80);
+	if(cpu.p & F_D){
+		// the 65C02 takes a cycle more and sets every flag from the decimal result
+		unsigned lo = (cpu.a & 0x0F) + (v & 0x0F) + c;
+		if(lo > 9){
+			lo += 6;
+		}
+		unsigned hi = (cpu.a >> 4) + (v >> 4) + (lo > 0x0F);
+		if(hi > 9){
+			hi += 6;
+		}
+		setFlag(F_C, hi > 0x0F);
+		setNZ(cpu.a = hi << 4 | (lo & 0x0F));
+		++cpu.cycles;
+		return;
+	}
+	setFlag(F_C, bin > 0xFF);
+	setNZ(cpu.a = bin);
+}
+
+static void sbc(uint8_t v){
+	unsigned borrow = !(cpu.p & F_C);
+	int bin = cpu.a - v - borrow;
+	setFlag(F_V, (cpu.a ^ v) & (cpu.a ^ bin) & 0x80);
+	setFlag(F_C, bin >= 0);
+	if(cpu.p & F_D){
+		int lo = (cpu.a & 0x0F) - (v & 0x0F) - (int)borrow;
+		int res = bin;
+		if(res < 0){
+			res -= 0x60;
+		}
+		if(lo < 0){
+			res -= 0x06;
+		}
+		setNZ(cpu.a = res);
+		++cpu.cycles;
+		return;
+	}
+	setNZ(cpu.a = bin);
+}
+
+static void compare(uint8_t r, uint8_t v){
+	setFlag(F_C, r >= v);
+	setNZ(r - v);
+}
+
+// shifts and rotates, carry in is put in bit 0 or 7
+static uint8_t shift(uint8_t v, bool left, bool rotate){
+	uint8_t in = rotate && (cpu.p & F_C) ? (left ? 0x01 : 0x80) : 0;
+	setFlag(F_C, left ? v & 0x80 : v & 0x01);
+	return setNZ((left ? v << 1 : v >> 1) | in);
+}
+
+// return the call node of label with parent, adding it if there is none
+static int32_t callChild(int32_t parent, int32_t label){
+	if(callNodes.elementCount * 2 >= childSlots){
+		free(childTable);
+		childSlots = childSlots ? childSlots * 2 : 1024;
+		testError((childTable = malloc(sizeof(int32_t) * childSlots)) == NULL, "call table alloc fail");
+		memset(childTable, 0xFF, sizeof(int32_t) * childSlots);
+		for(size_t n = 1; n < callNodes.elementCount; ++n){
+			struct CallNode* c = LIST_AT(&callNodes, struct CallNode, n);
+			size_t h = ((size_t)c->parent * 0x9E3779B1u + (size_t)c->label) & (childSlots - 1);
+			while(childTable[h] >= 0){
+				h = (h + 1) & (childSlots - 1);
+			}
+			childTable[h] = n;
+		}
+	}
+	size_t h = ((size_t)parent * 0x9E3779B1u + (size_t)label) & (childSlots - 1);
+	for(; childTable[h] >= 0; h = (h + 1) & (childSlots - 1)){
+		struct CallNode* c = LIST_AT(&callNodes, struct CallNode, childTable[h]);
+		if(c->parent == parent && c->label == label){
+			return childTable[h];
+		}
+	}
+	struct CallNode c = {.label = label, .parent = parent};
+	LIST_ADD(&callNodes, struct CallNode, &c, 1);
+	childTable[h] = callNodes.elementCount - 1;
+	return childTable[h];
+}
+
+static int compareRoutineAddrs(const void* a, const void* b){
+	const struct Routine* ra = a;
+	const struct Routine* rb = b;
+	return (ra->addr > rb->addr) - (ra->addr < rb->addr);
+}
+
+// find the code labels of the image and the label every address is at or after
+static void findRoutines(void){
+	bool* code = calloc(ADDRESS_SPACE, sizeof(bool));
+	testError(!code || !(labelAt = malloc(sizeof(int32_t) * ADDRESS_SPACE)), "routine table alloc fail");
+	for(int z = 0; z < fssize; ++z){
+		for(struct Instruction* i = listBeg(&filesArray[z].instructions); i != listEnd(&filesArray[z].instructions); ++i){
+			code[i->offset] = true;
+		}
+	}
+	for(int z = 0; z < fssize; ++z){
+		for(struct Label* l = listBeg(&filesArray[z].labels); l != listEnd(&filesArray[z].labels); ++l){
+			if(l->value >= 0 && l->value < ADDRESS_SPACE && code[l->value]){
+				struct Routine r = {.name = l->name, .addr = l->value};
+				LIST_ADD(&routines, struct Routine, &r, 1);
+			}
+		}
+	}
+	free(code);
+	qsort(listBeg(&routines), routines.elementCount, sizeof(struct Routine), compareRoutineAddrs);
+	// of labels at the same address the first one names it
+	int32_t label = NO_LABEL;
+	size_t r = 0;
+	for(uint32_t a = 0; a < ADDRESS_SPACE; ++a){
+		if(r < routines.elementCount && LIST_AT(&routines, struct Routine, r)->addr == a){
+			label = r;
+			while(r < routines.elementCount && LIST_AT(&routines, struct Routine, r)->addr == a){
+				++r;
+			}
+		}
+		labelAt[a] = label;
+	}
+}
+
+// set up memory from the image, rom segments and stubs
+static void loadImage(void){
+	memcpy(mem, memImage, ADDRESS_SPACE);
+	memset(kinds, RAM_KIND, ADDRESS_SPACE);
+	for(struct Segment* s = listBeg(&segments); s != listEnd(&segments); ++s){
+		if(s->rom){
+			memset(kinds + s->start, ROM_KIND, s->size);
+		}
+	}
+	for(size_t n = 0; n < stubs.elementCount; ++n){
+		struct Stub* s = LIST_AT(&stubs, struct Stub, n);
+		memset(kinds + s->start, STUB_KIND + n, s->end - s->start + 1);
+	}
+	for(int op = 0; op < 256; ++op){
+		decoded[op].name = IN_NULL;
+	}
+	for(int n = 0; n < IN_NULL; ++n){
+		for(int m = 0; m < AM_NULL; ++m){
+			if(opcodes[n][m]){
+				decoded[opcodes[n][m] - 1].name = n;
+				decoded[opcodes[n][m] - 1].mode = m;
+			}
+		}
+	}
+}
+
+// the assembler encodes bbr and bbs as a relative address only, where the processor reads a zero page address before it
+// so they are not run, see runImage
+static bool isBitBranch(uint8_t name){
+	return (name >= IN_BBR0 && name <= IN_BBR7) || (name >= IN_BBS0 && name <= IN_BBS7);
+}
+
+// enter a call to addr from call node from, for jsr, brk and interrupts
+static int32_t enterCall(int32_t from, uint16_t addr){
+	int32_t label = labelAt[addr];
+	if(label != NO_LABEL && LIST_AT(&routines, struct Routine, label)->addr == addr){
+		++LIST_AT(&routines, struct Routine, label)->calls;
+	}
+	struct Call c = {.frame = callChild(from, label), .from = from};
+	LIST_ADD(&callStack, struct Call, &c, 1);
+	return c.frame;
+}
+
+// leave the last call for rts and rti, return the call node it was made from
+// an rts with no call to leave, such as one used as a jump, keeps the call stack as it is
+static int32_t leaveCall(int32_t node){
+	if(!callStack.elementCount){
+		return node;
+	}
+	int32_t from = LIST_AT(&callStack, struct Call, callStack.elementCount - 1)->from;
+	--callStack.elementCount;
+	return from;
+}
+
+// return the call node of the last call not left yet, the root if there is none
+static int32_t lastCall(void){
+	return callStack.elementCount ? LIST_AT(&callStack, struct Call, callStack.elementCount - 1)->frame : 0;
+}
+
+// execute instructions until the cycle limit or a stop, return why it stopped
+static const char* execute(uint64_t limit){
+	// node is the call node of the label code runs at, frame the call node of the label last called
+	int32_t frame = 0, node = 0;
+	while(cpu.cycles < limit){
+		uint16_t pc = cpu.pc;
+		uint8_t op = readByte(pc);
+		uint8_t name = decoded[op].name, mode = decoded[op].mode;
+		if(name == IN_NULL){
+			return "opcode not valid";
+		}
+		if(isBitBranch(name)){
+			return "bbr or bbs";
+		}
+		uint16_t next = pc + modeSizes[mode];
+		uint64_t start = cpu.cycles;
+		cpu.cycles += opcodeCycles[op] & CYCLES_MASK;
+		++cpu.instructions;
+
+		// cycles go to the label the instruction is at, under the label last called
+		// code past another label than the one called shows under it, a jsr or brk counts as code of the caller
+		int32_t label = labelAt[pc];
+		if(LIST_AT(&callNodes, struct CallNode, node)->label != label){
+			node = LIST_AT(&callNodes, struct CallNode, frame)->label == label ? frame : callChild(frame, label);
+		}
+		int32_t at = node;
+
+		uint16_t addr = 0, base = 0;
+		switch(mode){
+			case AM_ABS:
+				addr = readWord(pc + 1);
+				break;
+			case AM_ABSX:
+				base = readWord(pc + 1);
+				addr = base + cpu.x;
+				break;
+			case AM_ABSY:
+				base = readWord(pc + 1);
+				addr = base + cpu.y;
+				break;
+			case AM_ABSI:
+				addr = readWord(readWord(pc + 1));
+				break;
+			case AM_ABSII:
+				addr = readWord(readWord(pc + 1) + cpu.x);
+				break;
+			case AM_IM:
+				addr = pc + 1;
+				break;
+			case AM_ZP:
+				addr = readByte(pc + 1);
+				break;
+			case AM_ZPX:
+				addr = (uint8_t)(readByte(pc + 1) + cpu.x);
+				break;
+			case AM_ZPY:
+				addr = (uint8_t)(readByte(pc + 1) + cpu.y);
+				break;
+			case AM_ZPII:
+				addr = readZeroPageWord(readByte(pc + 1) + cpu.x);
+				break;
+			case AM_ZPI:
+				addr = readZeroPageWord(readByte(pc + 1));
+				break;
+			case AM_ZPIIY:
+				base = readZeroPageWord(readByte(pc + 1));
+				addr = base + cpu.y;
+				break;
+			case AM_PCR:
+				addr = next + (int8_t)readByte(pc + 1);
+				break;
+			default:
+				break;
+		}
+		if((opcodeCycles[op] & CYCLES_PAGE) && (base ^ addr) & 0xFF00){
+			++cpu.cycles;
+		}
+		cpu.pc = next;
+
+		bool taken = false;
+		const char* stop = NULL;
+		switch(name){
+			case IN_ADC: adc(readByte(addr)); break;
+			case IN_SBC: sbc(readByte(addr)); break;
+			case IN_AND: setNZ(cpu.a &= readByte(addr)); break;
+			case IN_ORA: setNZ(cpu.a |= readByte(addr)); break;
+			case IN_EOR: setNZ(cpu.a ^= readByte(addr)); break;
+			case IN_CMP: compare(cpu.a, readByte(addr)); break;
+			case IN_CPX: compare(cpu.x, readByte(addr)); break;
+			case IN_CPY: compare(cpu.y, readByte(addr)); break;
+			case IN_BIT:{
+				uint8_t v = readByte(addr);
+				setFlag(F_Z, !(cpu.a & v));
+				// immediate bit only sets Z
+				if(mode != AM_IM){
+					cpu.p = (cpu.p & ~(F_N | F_V)) | (v & (F_N | F_V));
+				}
+				break;
+			}
+			case IN_LDA: setNZ(cpu.a = readByte(addr)); break;
+			case IN_LDX: setNZ(cpu.x = readByte(addr)); break;
+			case IN_LDY: setNZ(cpu.y = readByte(addr)); break;
+			case IN_STA: writeByte(addr, cpu.a); break;
+			case IN_STX: writeByte(addr, cpu.x); break;
+			case IN_STY: writeByte(addr, cpu.y); break;
+			case IN_STZ: writeByte(addr, 0); break;
+			case IN_ASL:
+			case IN_LSR:
+			case IN_ROL:
+			case IN_ROR:{
+				bool left = name == IN_ASL || name == IN_ROL, rotate = name == IN_ROL || name == IN_ROR;
+				if(mode == AM_ACC){
+					cpu.a = shift(cpu.a, left, rotate);
+				}else{
+					writeByte(addr, shift(readByte(addr), left, rotate));
+				}
+				break;
+			}
+			case IN_INC:
+			case IN_DEC:{
+				int d = name == IN_INC ? 1 : -1;
+				if(mode == AM_ACC){
+					setNZ(cpu.a += d);
+				}else{
+					writeByte(addr, setNZ(readByte(addr) + d));
+				}
+				break;
+			}
+			case IN_TSB:
+			case IN_TRB:{
+				uint8_t v = readByte(addr);
+				setFlag(F_Z, !(cpu.a & v));
+				writeByte(addr, name == IN_TSB ? v | cpu.a : v & ~cpu.a);
+				break;
+			}
+			case IN_INX: setNZ(++cpu.x); break;
+			case IN_INY: setNZ(++cpu.y); break;
+			case IN_DEX: setNZ(--cpu.x); break;
+			case IN_DEY: setNZ(--cpu.y); break;
+			case IN_TAX: setNZ(cpu.x = cpu.a); break;
+			case IN_TAY: setNZ(cpu.y = cpu.a); break;
+			case IN_TXA: setNZ(cpu.a = cpu.x); break;
+			case IN_TYA: setNZ(cpu.a = cpu.y); break;
+			case IN_TSX: setNZ(cpu.x = cpu.s); break;
+			case IN_TXS: cpu.s = cpu.x; break;
+			case IN_PHA: push(cpu.a); break;
+			case IN_PHX: push(cpu.x); break;
+			case IN_PHY: push(cpu.y); break;
+			case IN_PHP: push(cpu.p | F_B | F_U); break;
+			case IN_PLA: setNZ(cpu.a = pull()); break;
+			case IN_PLX: setNZ(cpu.x = pull()); break;
+			case IN_PLY: setNZ(cpu.y = pull()); break;
+			case IN_PLP: cpu.p = pull() | F_U; break;
+			case IN_CLC: cpu.p &= ~F_C; break;
+			case IN_CLD: cpu.p &= ~F_D; break;
+			case IN_CLI: cpu.p &= ~F_I; break;
+			case IN_CLV: cpu.p &= ~F_V; break;
+			case IN_SEC: cpu.p |= F_C; break;
+			case IN_SED: cpu.p |= F_D; break;
+			case IN_SEI: cpu.p |= F_I; break;
+			case IN_NOP: break;
+			case IN_BCC: taken = !(cpu.p & F_C); break;
+			case IN_BCS: taken = cpu.p & F_C; break;
+			case IN_BNE: taken = !(cpu.p & F_Z); break;
+			case IN_BEQ: taken = cpu.p & F_Z; break;
+			case IN_BPL: taken = !(cpu.p & F_N); break;
+			case IN_BMI: taken = cpu.p & F_N; break;
+			case IN_BVC: taken = !(cpu.p & F_V); break;
+			case IN_BVS: taken = cpu.p & F_V; break;
+			case IN_BRA: taken = true; break;
+			case IN_JMP:
+				cpu.pc = addr;
+				break;
+			case IN_JSR:
+				push((next - 1) >> 8);
+				push(next - 1);
+				cpu.pc = addr;
+				node = frame = enterCall(node, addr);
+				break;
+			case IN_RTS:
+				cpu.pc = pull();
+				cpu.pc = (cpu.pc | pull() << 8) + 1;
+				node = leaveCall(node);
+				frame = lastCall();
+				break;
+			case IN_BRK:
+				// brk skips the byte after it
+				push((next + 1) >> 8);
+				push(next + 1);
+				push(cpu.p | F_B | F_U);
+				cpu.p = (cpu.p | F_I) & ~F_D;
+				cpu.pc = readWord(0xFFFE);
+				node = frame = enterCall(node, cpu.pc);
+				break;
+			case IN_RTI:
+				cpu.p = pull() | F_U;
+				cpu.pc = pull();
+				cpu.pc |= pull() << 8;
+				node = leaveCall(node);
+				frame = lastCall();
+				break;
+			case IN_STP:
+				cpu.pc = pc;
+				stop = "stp";
+				break;
+			case IN_WAI:
+				// nothing raises interrupts, so it would wait forever
+				cpu.pc = pc;
+				stop = "wai";
+				break;
+			default:
+				if(name >= IN_RMB0 && name <= IN_RMB7){
+					writeByte(addr, readByte(addr) & ~(1 << (name - IN_RMB0)));
+				}else if(name >= IN_SMB0 && name <= IN_SMB7){
+					writeByte(addr, readByte(addr) | 1 << (name - IN_SMB0));
+				}
+		}
+		if(taken){
+			cpu.cycles += 1 + ((next ^ addr) & 0xFF00 ? 1 : 0);
+			cpu.pc = addr;
+		}
+
+		LIST_AT(&callNodes, struct CallNode, at)->cycles += cpu.cycles - start;
+		if(stop){
+			return stop;
+		}
+	}
+	return "cycle limit";
+}
+
+// write the call stack of node as labels separated by ; with the root first
+static void printStack(FILE* f, int32_t node){
+	struct CallNode* c = LIST_AT(&callNodes, struct CallNode, node);
+	if(c->parent > 0){
+		printStack(f, c->parent);
+		fputc(';', f);
+	}
+	fputs(c->label == NO_LABEL ? "(none)" : stringAt(LIST_AT(&routines, struct Routine, c->label)->name), f);
+}
+
+static int compareRoutineSelf(const void* a, const void* b){
+	const struct Routine* ra = a;
+	const struct Routine* rb = b;
+	return (ra->self < rb->self) - (ra->self > rb->self);
+}
+
+void runImage(uint64_t cycles, const char* folded){
+	loadImage();
+	for(int z = 0; z < fssize; ++z){
+		for(struct Instruction* i = listBeg(&filesArray[z].instructions); i != listEnd(&filesArray[z].instructions); ++i){
+			testError(isBitBranch(decoded[i->opcode].name), "--run can't run bbr or bbs at %.4X in file \"%s\", they are assembled without the zero page address the processor reads", i->offset, filesArray[z].name);
+		}
+	}
+	findRoutines();
+	struct CallNode root = {.label = NO_LABEL, .parent = -1};
+	LIST_ADD(&callNodes, struct CallNode, &root, 1);
+	cpu.s = 0xFF;
+	cpu.p = F_U | F_I;
+	cpu.pc = readWord(0xFFFC);
+	// the reset sequence takes 7 cycles
+	cpu.cycles = 7;
+	const char* stop = execute(cycles);
+	printf("ran %llu instructions in %llu cycles, stopped at %.4X by %s\n", (unsigned long long)cpu.instructions, (unsigned long long)cpu.cycles, cpu.pc, stop);
+
+	// a label's total counts each call stack once even if the label is in it more than once
+	uint64_t* totals = calloc(callNodes.elementCount, sizeof(uint64_t));
+	testError(!totals, "profile alloc fail");
+	for(size_t n = callNodes.elementCount; n-- > 1;){
+		struct CallNode* c = LIST_AT(&callNodes, struct CallNode, n);
+		totals[n] += c->cycles;
+		totals[c->parent] += totals[n];
+		if(c->label != NO_LABEL){
+			LIST_AT(&routines, struct Routine, c->label)->self += c->cycles;
+		}
+	}
+	for(size_t n = 1; n < callNodes.elementCount; ++n){
+		struct CallNode* c = LIST_AT(&callNodes, struct CallNode, n);
+		bool outer = c->label != NO_LABEL;
+		for(int32_t p = c->parent; p > 0 && outer; p = LIST_AT(&callNodes, struct CallNode, p)->parent){
+			outer = LIST_AT(&callNodes, struct CallNode, p)->label != c->label;
+		}
+		if(outer){
+			LIST_AT(&routines, struct Routine, c->label)->total += totals[n];
+		}
+	}
+	free(totals);
+
+	if(folded){
+		FILE* f = fopen(folded, "w");
+		testError(!f, "failed to open \"%s\": %s", folded, strerror(errno));
+		for(size_t n = 0; n < callNodes.elementCount; ++n){
+			struct CallNode* c = LIST_AT(&callNodes, struct CallNode, n);
+			if(c->cycles){
+				printStack(f, n);
+				fprintf(f, " %llu\n", (unsigned long long)c->cycles);
+			}
+		}
+		testError(fclose(f), "failed to write \"%s\": %s", folded, strerror(errno));
+	}
+
+	qsort(listBeg(&routines), routines.elementCount, sizeof(struct Routine), compareRoutineSelf);
+	printf("%12s %6s %12s %10s  %s\n", "SELF", "SELF%", "TOTAL", "CALLS", "LABEL");
+	for(struct Routine* r = listBeg(&routines); r != listEnd(&routines); ++r){
+		if(r->self || r->total || r->calls){
+			printf("%12llu %5.1f%% %12llu %10llu  %s\n", (unsigned long long)r->self, 100.0 * r->self / (cpu.cycles ? cpu.cycles : 1), (unsigned long long)r->total, (unsigned long long)r->calls, stringAt(r->name));
+		}
+	}
+	for(struct Stub* s = listBeg(&stubs); s != listEnd(&stubs); ++s){
+		printf("stub %.4X-%.4X: %llu reads, %llu writes\n", s->start, s->end, (unsigned long long)s->reads, (unsigned long long)s->writes);
+	}
+}
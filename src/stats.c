@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include "stats.h"
+
+#ifdef MBASM_STATS
+
+#include <inttypes.h>
+#include <string.h>
+#include <pthread.h>
+#include "types.h"
+#include "utility.h"
+#include "list.h"
+#include "stringmanip.h"
+
+const int statsAvailable = 1;
+_Thread_local struct Stats stats;
+static struct Stats totals;
+static pthread_mutex_t totalsLock = PTHREAD_MUTEX_INITIALIZER;
+
+void statsFlush(void){
+	pthread_mutex_lock(&totalsLock);
+	totals.evalCalls += stats.evalCalls;
+	totals.labelLookups += stats.labelLookups;
+	totals.stringHits += stats.stringHits;
+	totals.stringMisses += stats.stringMisses;
+	totals.commandAttempts += stats.commandAttempts;
+	totals.commandsFirst += stats.commandsFirst;
+	totals.commandsRetried += stats.commandsRetried;
+	totals.cacheHits += stats.cacheHits;
+	totals.cacheMisses += stats.cacheMisses;
+	// peaks of different threads are held at the same time
+	totals.errorBytes += stats.errorBytes;
+	pthread_mutex_unlock(&totalsLock);
+	memset(&stats, 0, sizeof(stats));
+}
+
+void printStats(void){
+	statsFlush();
+
+	// lists of a file only grow until the file is freed, so the bytes they hold now are their peak
+	size_t pieces = 0, labels = 0, instructions = 0, relocs = 0, commands = 0, exprs = 0;
+	for(int z = 0; z < fssize; ++z){
+		struct FileData* f = filesArray + z;
+		pieces += f->pieces.types.bytesAllocated + f->pieces.values.bytesAllocated;
+		labels += f->labels.bytesAllocated;
+		instructions += f->instructions.bytesAllocated;
+		relocs += f->relocs.bytesAllocated;
+		commands += f->commands.bytesAllocated;
+		exprs += f->exprs.bytesAllocated + f->code.bytesAllocated;
+	}
+
+	printf("peak bytes held:\n");
+	printf("  pieces        %zu\n", pieces);
+	printf("  labels        %zu\n", labels);
+	printf("  instructions  %zu\n", instructions);
+	printf("  relocations   %zu\n", relocs);
+	printf("  commands      %zu\n", commands);
+	printf("  expressions   %zu\n", exprs);
+	printf("  strings       %zu\n", stringTableBytes());
+	printf("  errors        %" PRIu64 "\n", totals.errorBytes);
+	printf("evalExpression calls    %" PRIu64 "\n", totals.evalCalls);
+	printf("label lookups           %" PRIu64 "\n", totals.labelLookups);
+	printf("command attempts        %" PRIu64 "\n", totals.commandAttempts);
+	printf("commands resolved:\n");
+	printf("  on first attempt      %" PRIu64 "\n", totals.commandsFirst);
+	printf("  after waiting         %" PRIu64 "\n", totals.commandsRetried);
+	printf("addString hits          %" PRIu64 "\n", totals.stringHits);
+	printf("addString misses        %" PRIu64 "\n", totals.stringMisses);
+	printf("cache hits              %" PRIu64 "\n", totals.cacheHits);
+	printf("cache misses            %" PRIu64 "\n", totals.cacheMisses);
+}
+
+#else
+
+const int statsAvailable = 0;
+
+void statsFlush(void){
+}
+
+void printStats(void){
+}
+
+#endif
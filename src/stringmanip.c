@@ -1,8 +1,11 @@
 #include "stringmanip.h"
 #include "list.h"
+#include "error.h"
+#include "arena.h"
+#include "stats.h"
 #include <string.h>
+#include <stdlib.h>
 
-extern struct List stringCharsList;
 // parse a string representing an integer and return it
 int strToInt(const char s[], int len){
 	if(len <= 0){
@@ -40,38 +43,114 @@ int strToInt(const char s[], int len){
 	return value;
 }
 
-char* stringAt(int i){
-	int ct = 0;
-	char* a = listBeg(stringCharsList);
-	while(a < (char*)listEnd(stringCharsList)){
-		if(ct == i){
-			return a;
+// table used by the main thread and after merging, other threads select their own with useStrings
+static struct StringTable globalStrings = {
+	.chars = {.allocStep = 1000, .elementSize = 1, .arena = &globalArena},
+	.offsets = {.allocStep = 100, .elementSize = sizeof(size_t), .arena = &globalArena}
+};
+static _Thread_local struct StringTable* strings = &globalStrings;
+
+// FNV-1a hash of s characters from c
+static size_t hashString(const char* c, int s){
+	size_t h = 2166136261u;
+	for(int idx = 0; idx < s; ++idx){
+		h ^= (unsigned char)c[idx];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+// find the table slot holding string c of length s, or the empty slot where it would go
+static int* findSlot(const char* c, int s){
+	size_t mask = strings->tableCap - 1;
+	for(size_t slot = hashString(c, s) & mask;; slot = (slot + 1) & mask){
+		int id = strings->table[slot];
+		if(id == 0){
+			return strings->table + slot;
+		}
+		char* a = stringAt(id - 1);
+		if(!strncmp(a, c, s) && a[s] == '\0'){
+			return strings->table + slot;
 		}
-		a += strlen(a) + 1;
-		++ct;
 	}
-	return NULL;
 }
 
-int findString(char* c, int s){
-	int idx = 0;
-	for(char* a = listBeg(stringCharsList); a < (char*)listEnd(stringCharsList); a += strlen(a) + 1){
-		if(!strncmp(a, c, s) && s == strlen(a)){
-			return idx;
+// double the table size (or create it) and reinsert every string id
+static void growTable(void){
+	int* old = strings->table;
+	size_t oldCap = strings->tableCap;
+	strings->tableCap = oldCap ? oldCap * 2 : 256;
+	strings->table = calloc(strings->tableCap, sizeof(int));
+	testError(!strings->table, "failed to allocate string hash table");
+	for(size_t slot = 0; slot < oldCap; ++slot){
+		if(old[slot]){
+			char* a = stringAt(old[slot] - 1);
+			*findSlot(a, strlen(a)) = old[slot];
 		}
-		idx++;
 	}
-	return -(idx + 1);
+	free(old);
+}
+
+struct StringTable newStringTable(void){
+	struct StringTable t = {
+		.chars = listNew(1, 1000),
+		.offsets = listNew(sizeof(size_t), 100)
+	};
+	return t;
+}
+
+void stringTableZero(struct StringTable* t){
+	listZero(&t->chars);
+	listZero(&t->offsets);
+	free(t->table);
+	t->table = NULL;
+	t->tableCap = 0;
+}
+
+struct StringTable* useStrings(struct StringTable* t){
+	struct StringTable* prev = strings;
+	strings = t ? t : &globalStrings;
+	return prev;
 }
 
-int addString(char* c, int s){
+char* stringAt(int i){
+	size_t* off = listAt(&strings->offsets, i);
+	if(i < 0 || !off){
+		return NULL;
+	}
+	return LIST_BEG(&strings->chars, char) + *off;
+}
+
+int findString(const char* c, int s){
+	if(strings->tableCap){
+		int id = *findSlot(c, s);
+		if(id){
+			return id - 1;
+		}
+	}
+	return -((int)strings->offsets.elementCount + 1);
+}
+
+size_t stringTableBytes(void){
+	return strings->chars.bytesAllocated + strings->offsets.bytesAllocated + strings->tableCap * sizeof(int);
+}
+
+int addString(const char* c, int s){
 	int idx = findString(c, s);
 	if(idx < 0){
-		static char n = 0;
-		listAdd(&stringCharsList, c, s);
-		listAdd(&stringCharsList, &n, 1);
+		STAT_ADD(stringMisses, 1);
+		static const char n = 0;
+		size_t off = strings->chars.elementCount;
+		listAdd(&strings->chars, c, s);
+		listAdd(&strings->chars, &n, 1);
+		listAdd(&strings->offsets, &off, 1);
+		if(strings->offsets.elementCount * 2 > strings->tableCap){
+			growTable();
+		}
+		*findSlot(c, s) = strings->offsets.elementCount;
 		return -idx - 1;
 	}else{
+		STAT_ADD(stringHits, 1);
 		return idx;
 	}
 }
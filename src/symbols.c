@@ -0,0 +1,42 @@
+#include "symbols.h"
+#include "list.h"
+#include "utility.h"
+
+// location of a label, the labels list of a file can be reallocated so pointers are not kept
+struct Symbol{
+	uint32_t file;		// index into filesArray of the file the label is stored in plus 1, 0 if no label has the name
+	uint32_t idx;		// index into the labels list of the file
+};
+
+// symbols indexed directly by interned string id, string ids are dense so this works as a perfect hash
+static struct List symbolTable = {.allocStep = 100, .elementSize = sizeof(struct Symbol)};
+
+void addLabel(struct FileData* f, struct Label l){
+	listAdd(&f->labels, &l, 1);
+	static const struct Symbol empty = {.file = 0};
+	while(symbolTable.elementCount <= l.name){
+		listAdd(&symbolTable, &empty, 1);
+	}
+	struct Symbol* s = listAt(&symbolTable, l.name);
+	if(!s->file){
+		s->file = f - filesArray + 1;
+		s->idx = f->labels.elementCount - 1;
+	}
+}
+
+void clearLabels(void){
+	symbolTable.elementCount = 0;
+}
+
+struct Label* findLabel(size_t name){
+	struct Symbol* s = listAt(&symbolTable, name);
+	if(!s || !s->file){
+		return NULL;
+	}
+	return listAt(&filesArray[s->file - 1].labels, s->idx);
+}
+
+struct FileData* labelFile(size_t name){
+	struct Symbol* s = listAt(&symbolTable, name);
+	return s && s->file ? filesArray + s->file - 1 : NULL;
+}
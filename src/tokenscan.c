@@ -0,0 +1,136 @@
+#include "tokenscan.h"
+#include "types.h"
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+const bool isBoundary[256] = {
+	['\0'] = true,
+	['\t'] = true,
+	[' '] = true,
+	[';'] = true,
+	[PT_LINE] = true,
+	[PT_DOT] = true,
+	[PT_EXPR_DELIM] = true,
+	[PT_ADD] = true,
+	[PT_SUB] = true,
+	[PT_LITERAL] = true,
+	[PT_RSHIFT] = true,
+	[PT_LSHIFT] = true,
+};
+
+static const char* scanScalar(const char* c, const char* end){
+	while(c < end && !isBoundary[(unsigned char)*c]){
+		++c;
+	}
+	return c;
+}
+
+#ifdef SIMD_X86
+// the symbol characters '+' ',' '-' '.' are consecutive and checked as one range
+// the rest are compared one by one
+
+__attribute__((target("sse2")))
+static const char* scanSSE2(const char* c, const char* end){
+	const __m128i rangeLow = _mm_set1_epi8(PT_ADD), rangeLen = _mm_set1_epi8(PT_DOT - PT_ADD);
+	for(; end - c >= 16; c += 16){
+		__m128i v = _mm_loadu_si128((const __m128i*)c);
+		__m128i r = _mm_sub_epi8(v, rangeLow);
+		__m128i m = _mm_cmpeq_epi8(_mm_min_epu8(r, rangeLen), r);
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(PT_LINE)));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(PT_LITERAL)));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(';')));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(PT_LSHIFT)));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(PT_RSHIFT)));
+		int mask = _mm_movemask_epi8(m);
+		if(mask){
+			return c + __builtin_ctz(mask);
+		}
+	}
+	return scanScalar(c, end);
+}
+
+__attribute__((target("avx2")))
+static const char* scanAVX2(const char* c, const char* end){
+	const __m256i rangeLow = _mm256_set1_epi8(PT_ADD), rangeLen = _mm256_set1_epi8(PT_DOT - PT_ADD);
+	for(; end - c >= 32; c += 32){
+		__m256i v = _mm256_loadu_si256((const __m256i*)c);
+		__m256i r = _mm256_sub_epi8(v, rangeLow);
+		__m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(r, rangeLen), r);
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(PT_LINE)));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(PT_LITERAL)));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';')));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(PT_LSHIFT)));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(PT_RSHIFT)));
+		unsigned mask = _mm256_movemask_epi8(m);
+		if(mask){
+			return c + __builtin_ctz(mask);
+		}
+	}
+	return scanSSE2(c, end);
+}
+#endif
+
+static const struct{
+	const char* name;
+	const char* (*func)(const char*, const char*);
+} scanners[] = {
+	{"scalar", scanScalar},
+#ifdef SIMD_X86
+	{"sse2", scanSSE2},
+	{"avx2", scanAVX2},
+#endif
+};
+
+// index into scanners of the implementation in use, chosen before main runs so threads only read it
+static int current = 0;
+
+static bool supported(const char* name){
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if(!strcmp(name, "sse2")){
+		return __builtin_cpu_supports("sse2");
+	}
+	if(!strcmp(name, "avx2")){
+		return __builtin_cpu_supports("avx2");
+	}
+#endif
+	return !strcmp(name, "scalar");
+}
+
+__attribute__((constructor))
+static void selectBest(void){
+	for(int a = 0; a < sizeof(scanners) / sizeof(scanners[0]); ++a){
+		if(supported(scanners[a].name)){
+			current = a;
+		}
+	}
+}
+
+const char* findBoundary(const char* c, const char* end){
+	return scanners[current].func(c, end);
+}
+
+bool selectBoundaryScanner(const char* name){
+	for(int a = 0; a < sizeof(scanners) / sizeof(scanners[0]); ++a){
+		if(!strcmp(scanners[a].name, name) && supported(name)){
+			current = a;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* boundaryScannerName(void){
+	return scanners[current].name;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "trace.h"
+#include "list.h"
+#include "error.h"
+
+// one begin or end event
+struct TraceEvent{
+	const char* name;	// phase name, NULL for end events
+	const char* file;	// input file of the phase or NULL
+	double ts;		// microseconds since traceOpen
+	int tid;		// trace id of the thread that recorded the event
+	char ph;		// 'B' or 'E'
+};
+
+bool traceEnabled = false;
+static const char* traceName;
+static struct timespec traceStart;
+static struct List traceEvents = {.allocStep = 256, .elementSize = sizeof(struct TraceEvent)};
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+
+// threads are numbered in the order they record their first event, the main thread opens the trace so it is 1
+static atomic_int nextTid = 1;
+static _Thread_local int traceTid;
+
+static void addEvent(char ph, const char* name, const char* file){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	if(!traceTid){
+		traceTid = atomic_fetch_add(&nextTid, 1);
+	}
+	struct TraceEvent e = {
+		.name = name,
+		.file = file,
+		.ts = (t.tv_sec - traceStart.tv_sec) * 1e6 + (t.tv_nsec - traceStart.tv_nsec) / 1e3,
+		.tid = traceTid,
+		.ph = ph,
+	};
+	pthread_mutex_lock(&traceLock);
+	listAdd(&traceEvents, &e, 1);
+	pthread_mutex_unlock(&traceLock);
+}
+
+void traceBegin(const char* name, const char* file){
+	if(traceEnabled){
+		addEvent('B', name, file);
+	}
+}
+
+void traceEnd(void){
+	if(traceEnabled){
+		addEvent('E', NULL, NULL);
+	}
+}
+
+// write s as a json string
+static void writeJsonString(FILE* out, const char* s){
+	fputc('"', out);
+	for(; *s; ++s){
+		unsigned char c = *s;
+		if(c == '"' || c == '\\'){
+			fprintf(out, "\\%c", c);
+		}else if(c < 0x20){
+			fprintf(out, "\\u%.4x", c);
+		}else{
+			fputc(c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+// runs at exit so a trace is written for failed runs too
+static void traceWrite(void){
+	FILE* out = fopen(traceName, "w");
+	if(!out){
+		fprintf(stderr, "failed to open trace file \"%s\"\n", traceName);
+		return;
+	}
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+	pthread_mutex_lock(&traceLock);
+	for(struct TraceEvent* e = listBeg(&traceEvents); e != listEnd(&traceEvents); ++e){
+		fprintf(out, "%s{\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", e == listBeg(&traceEvents) ? "" : ",\n", e->ph, e->tid, e->ts);
+		if(e->name){
+			fputs(",\"cat\":\"mbasm\",\"name\":", out);
+			writeJsonString(out, e->name);
+		}
+		if(e->file){
+			fputs(",\"args\":{\"file\":", out);
+			writeJsonString(out, e->file);
+			fputc('}', out);
+		}
+		fputc('}', out);
+	}
+	listZero(&traceEvents);
+	pthread_mutex_unlock(&traceLock);
+	fputs("\n]}\n", out);
+	if(fclose(out)){
+		fprintf(stderr, "failed to write trace file \"%s\"\n", traceName);
+	}
+}
+
+void traceOpen(const char* name){
+	traceName = name;
+	clock_gettime(CLOCK_MONOTONIC, &traceStart);
+	traceEnabled = true;
+	testError(atexit(traceWrite), "failed to register trace output");
+}
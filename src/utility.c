@@ -6,111 +6,58 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "ins_values.h"
 #include "stringmanip.h"
+#include "symbols.h"
+#include "tokenscan.h"
+#include "expr.h"
+#include "relax.h"
 #include <stdio.h>
 
-// evaluate an expression from an array of pieces starting at p and store the result in res, return if it was successful
-bool evalExpression(struct Piece p[], int* res){
-	struct List valueList = listNew(sizeof(int), 10);
-	int result = 0;
-	for(; !IS_EXPR_END(p->type); ++p){
-		switch(p->type){
-			case PT_STRING:
-				// is a label, find a matching name and use it if it is a defined label
-				;
-				int found = 0;
-				for(int a = 0; a < fssize; ++a){
-					for(struct Label* l = listBeg(filesArray[a].labels); l != listEnd(filesArray[a].labels); ++l){
-						if(!strcmp(stringAt(l->name), stringAt(p->stridx))){
-							++found;
-							if(l->type == LT_DEFINED){
-								++found;
-								listAdd(&valueList, &l->value, 1);
-							}
-							break;
-						}
-					}
-					if(found){
-						break;
-					}
-				}
-				if(found != 2){
-					addErrorMessage("string \"%s\" did not match any defined labels", stringAt(p->stridx));
-					return false;
-				}
-				break;
-			case PT_INTEGER:
-				listAdd(&valueList, &p->integer, 1);
-				break;
-			case PT_ADD:
-			case PT_SUB:
-			case PT_RSHIFT:
-			case PT_LSHIFT:
-				// do the math operation
-				;
-				int* v = listAt(valueList, 0);
-				for(size_t a = 0; a < valueList.elementCount; ++a){
-					switch(p->type){
-						case PT_ADD:
-							result += v[a];
-							break;
-						case PT_SUB:
-							result -= v[a];
-							break;
-						case PT_RSHIFT:
-							result >>= v[a];
-							break;
-						case PT_LSHIFT:
-							result <<= v[a];
-							break;
-					}
-				}
-				valueList.elementCount = 0;
-				break;
-			default:
-				addErrorMessage("piece type not good for evaluation sequence");
-				return false;
-		}
-	}
-	int* v = listAt(valueList, 0);
-	for(size_t a = 0; a < valueList.elementCount; ++a){
-		result += v[a];
-	}
-	*res = result;
-	listZero(&valueList);
-	return true;
+struct FileData* filesArray;
+int fssize;
+_Thread_local unsigned char* memImage;
+_Thread_local size_t memIdx = 0;
+
+void addPiece(struct FileData* f, enum PieceType type, uint32_t value){
+	uint8_t t = type;
+	LIST_ADD(&f->pieces.types, uint8_t, &t, 1);
+	LIST_ADD(&f->pieces.values, uint32_t, &value, 1);
 }
 
-int exprArrayLen(const struct Piece p[]){
+int exprArrayLen(const struct FileData* f, size_t p){
 	int ct = 1;
-	while(!IS_EXPR_END(p->type)){
+	while(!IS_EXPR_END(pieceType(f, p))){
 		++p;
 		++ct;
 	}
 	if(ct == 0) ct = 1;
-	return p->type == PT_LINE ? -ct : ct;
+	return pieceType(f, p) == PT_LINE ? -ct : ct;
 }
 
-char* printExpr(struct Piece p[]){
+char* printExpr(const struct FileData* f, size_t p){
 	static char exprbuf[200] = {0};
 	static char formatbuf[100] = {0};
 	exprbuf[0] = 0;
 	formatbuf[0] = 0;
-	for(; !IS_EXPR_END(p->type); ++p){
-		switch(p->type){
+	for(; !IS_EXPR_END(pieceType(f, p)); ++p){
+		switch(pieceType(f, p)){
 			case PT_STRING:
-				strcat(exprbuf, stringAt(p->stridx));
+				strcat(exprbuf, stringAt(pieceString(f, p)));
 				strcat(exprbuf, " ");
 				break;
 			case PT_INTEGER:
-				sprintf(formatbuf, "%d ", p->integer);
+				sprintf(formatbuf, "%d ", pieceInteger(f, p));
 				strcat(exprbuf, formatbuf);
 				break;
 			default:
 				// symbol piece, puts the ascii character
 				formatbuf[1] = 0;
-				formatbuf[0] = p->type;
+				formatbuf[0] = pieceType(f, p);
 				strcat(exprbuf, formatbuf);
 				strcat(exprbuf, " ");
 				break;
@@ -119,38 +66,49 @@ char* printExpr(struct Piece p[]){
 	return exprbuf;
 }
 
-// create a chain of pieces from input text and use the string "symbols" as symbol characters
+// create a chain of pieces from input text, the characters in isBoundary other than whitespace are symbols
 void createPieces(struct FileData* f){
-	static const char symbols[] = {
-		PT_DOT,
-		PT_EXPR_DELIM,
-		PT_ADD,
-		PT_SUB,
-		PT_RSHIFT,
-		PT_LSHIFT,
-		PT_LITERAL,
-		PT_LINE,
-		';',
-		0
-	};
+	int fd = open(f->name, O_RDONLY);
+	testError(fd < 0, "error opening file \"%s\": %s", f->name, strerror(errno));
+	struct stat st;
+	testError(fstat(fd, &st), "error reading file \"%s\": %s", f->name, strerror(errno));
+	fileDataUseArena(f, st.st_size);
+
+	// map the whole file read only, an empty file has no pieces and can't be mapped
+	const char* data = NULL;
+	if(st.st_size){
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		testError(data == MAP_FAILED, "error mapping file \"%s\": %s", f->name, strerror(errno));
+		madvise((void*)data, st.st_size, MADV_SEQUENTIAL);
+	}
+	const char* end = data + st.st_size;
 
-	FILE* file = fopen(f->name, "r");
-	testError(!file, "error opening file \"%s\": %s", f->name, strerror(errno));
+	// upper case copy of the current token, the mapped file is never written
+	char* fold = NULL;
+	int foldSize = 0;
+
+	const char* lineEnd;
+	for(const char* line = data; line < end; line = lineEnd){
+		// each line includes its \n, characters past the end of a line read as \0
+		lineEnd = memchr(line, '\n', end - line);
+		lineEnd = lineEnd ? lineEnd + 1 : end;
 
-	char* line = NULL;
-	size_t n = 0;
-	while(getline(&line, &n, file) != -1){
 		bool inString = false, inLit = false;
-		char* c = line;
-		char* stringPieceBegin = c;
+		const char* c = line;
+		const char* stringPieceBegin = c;
 		while(true){
+			// characters inside a token or literal change nothing until a boundary character
+			if(inString){
+				c = findBoundary(c, lineEnd);
+			}
+			char ch = c < lineEnd ? *c : '\0';
 			// get symbol if current char matches, or set line end if not \n and is ; or \0
 			char symbol = 0;
-			if(strchr(symbols, *c)){
-				symbol = *c;
-				if(*c == '\0' || *c == ';'){
+			if(isBoundary[(unsigned char)ch] && ch != ' ' && ch != '\t'){
+				symbol = ch;
+				if(ch == '\0' || ch == ';'){
 					symbol = PT_LINE;
-				}else if(*c == PT_LITERAL && !inLit){
+				}else if(ch == PT_LITERAL && !inLit){
 					inLit = true;
 					inString = true;
 					stringPieceBegin = c + 1;
@@ -164,13 +122,9 @@ void createPieces(struct FileData* f){
 				if(symbol == PT_LINE || symbol == PT_LITERAL){
 					inLit = false;
 					inString = false;
-					struct Piece p;
-					p.type = PT_STRING;
-					p.stridx = addString(stringPieceBegin, c - stringPieceBegin);
-					listAdd(&f->pieces, &p, 1);
+					addPiece(f, PT_STRING, addString(stringPieceBegin, c - stringPieceBegin));
 					if(symbol == PT_LINE){
-						p.type = PT_LINE;
-						listAdd(&f->pieces, &p, 1);
+						addPiece(f, PT_LINE, 0);
 					}
 				}
 				++c;
@@ -179,35 +133,34 @@ void createPieces(struct FileData* f){
 
 			// if start of new non ws area, begin new string
 			// else if ws or symbol, end current string
-			if(!inString && *c != ' ' && *c != '\t'){
+			if(!inString && ch != ' ' && ch != '\t'){
 				inString = true;
 				stringPieceBegin = c;
-			}else if(inString && (symbol || *c == ' ' || *c == '\t')){
+			}else if(inString && (symbol || ch == ' ' || ch == '\t')){
 				inString = false;
 				int len = c - stringPieceBegin;
 
+				if(len > foldSize){
+					foldSize = len * 2;
+					testError((fold = realloc(fold, foldSize)) == NULL, "token buffer alloc fail (%d bytes)", foldSize);
+				}
 				for(int a = 0; a < len; ++a){
-					stringPieceBegin[a] = toupper(stringPieceBegin[a]);
+					fold[a] = toupper((unsigned char)stringPieceBegin[a]);
 				}
 
 				// add piece to piece list
 				int v;
-				struct Piece p;
-				if((v = strToInt(stringPieceBegin, len)) >= 0){
-					p.type = PT_INTEGER;
-					p.integer = v;
+				if((v = strToInt(fold, len)) >= 0){
+					addPiece(f, PT_INTEGER, v);
 				}else{
-					p.type = PT_STRING;
-					p.stridx = addString(stringPieceBegin, len);
+					addPiece(f, PT_STRING, addString(fold, len));
 				}
-				listAdd(&f->pieces, &p, 1);
 			}
 
 			// add symbol if found and not a comment symbol and cancel string
 			if(symbol){
 				inString = false;
-				struct Piece p = {.type = symbol};
-				listAdd(&f->pieces, &p, 1);
+				addPiece(f, symbol, 0);
 				// break on newline to loop to next line
 				if(symbol == PT_LINE){
 					break;
@@ -216,8 +169,11 @@ void createPieces(struct FileData* f){
 			++c;
 		}
 	}
-	free(line);
-	testError(fclose(file), "error closing file \"%s\": %s", f->name, strerror(errno));
+	free(fold);
+	if(data){
+		testError(munmap((void*)data, st.st_size), "error unmapping file \"%s\": %s", f->name, strerror(errno));
+	}
+	testError(close(fd), "error closing file \"%s\": %s", f->name, strerror(errno));
 }
 
 // 0 = good, else failed at that line
@@ -234,27 +190,36 @@ int scanPieces(struct FileData* f){
 	 */
 
 	errorLine = 1;
-	for(struct Piece* p = listBeg(f->pieces); p != listEnd(f->pieces); ++p){
+	const uint8_t* types = listBeg(&f->pieces.types);
+	for(size_t p = 0; p < f->pieces.types.elementCount; ++p){
 		// a beginning PT_DOT is a command, a PT_STRING is and instruction, and not a PT_LINE is an error
-		if(p->type == PT_DOT){
+		if(types[p] == PT_DOT){
 			// command line, send the line starting at 1 after PT_DOT to PT_LINE
 			if(!commandHandler(++p, f)){
 				addErrorMessage("command handler failure");
 				return errorLine;
 			}
+			if(memIdx > ADDRESS_SPACE){
+				addErrorMessage("data goes past the end of the address space");
+				return errorLine;
+			}
 			// go to end of line
-			while(p->type != PT_LINE){
+			while(types[p] != PT_LINE){
 				++p;
 			}
-		}else if(p->type == PT_STRING){
+		}else if(types[p] == PT_STRING){
 			// instruction line
 			struct Instruction i;
 
-			if((p = getInsLine(p, &i, f)) == NULL){
+			if((p = getInsLine(p, &i, f)) == 0){
 				addErrorMessage("failed to form instruction from line");
 				return errorLine;
 			}
 			listAdd(&f->instructions, &i, 1);
+			if(memIdx + i.size > ADDRESS_SPACE){
+				addErrorMessage("code goes past the end of the address space");
+				return errorLine;
+			}
 
 			// add instruction to memory
 			memImage[memIdx++] = i.opcode;
@@ -264,7 +229,7 @@ int scanPieces(struct FileData* f){
 			if(i.size == 3){
 				memImage[memIdx++] = i.value >> 8;
 			}
-		}else if(p->type != PT_LINE){
+		}else if(types[p] != PT_LINE){
 			addErrorMessage("line not recognized as a command or instruction: must start with an instruction name or \".\"");
 			return errorLine;
 		}
@@ -274,20 +239,20 @@ int scanPieces(struct FileData* f){
 }
 
 // process an instruction line starting at piece pidx and put the reults into out, returning an index to the piece last scanned (end of line piece)
-struct Piece* getInsLine(struct Piece p[], struct Instruction* out, struct FileData* f){
-	struct Instruction ins = {.expr = 0, .offset = memIdx, .size = 1};
+size_t getInsLine(size_t p, struct Instruction* out, struct FileData* f){
+	struct Instruction ins = {.expr = EXPR_NONE, .offset = memIdx, .size = 1};
 
 	// find the instruction name, ex: name of STA 0X8009 is STA
 	enum InstructionName insName = IN_NULL;
 	for(int idx = 0; insNameStrings[idx]; ++idx){
-		if(!strcmp(stringAt(p->stridx), insNameStrings[idx])){
+		if(!strcmp(stringAt(pieceString(f, p)), insNameStrings[idx])){
 			insName = idx; // enum identifer has value of index of string of enum identifier ([IN_AND] = "AND")
 			break;
 		}
 	}
 	if(insName == IN_NULL){
-		addErrorMessage("instruction not recognized: %s", stringAt(p->stridx));
-		return NULL;
+		addErrorMessage("instruction not recognized: %s", stringAt(pieceString(f, p)));
+		return 0;
 	}
 
 	char insMode[3] = {0};
@@ -296,7 +261,7 @@ struct Piece* getInsLine(struct Piece p[], struct Instruction* out, struct FileD
 
 	// if line ends or there is a expression delim, then there was no expression, so no value, so no mode flags
 	// INC ,X will not work as expected (but syntax is ok) and be the acc mode
-	if(IS_EXPR_END(p->type)){
+	if(IS_EXPR_END(pieceType(f, p))){
 		goto INS_NO_VAL;
 	}
 
@@ -304,38 +269,44 @@ struct Piece* getInsLine(struct Piece p[], struct Instruction* out, struct FileD
 	insMode[0] = 'V';
 
 	// early expression evaluation, can fail and retry later, but this step determines if zeropage ins or not
+	size_t expr = compileExpression(p, f);
+	if(expr == EXPR_NONE){
+		return 0;
+	}
 	int v;
-	if(evalExpression(p, &v)){
+	if(evalExpression(f, expr, &v)){
 		ins.value = v;
 		if(v <= 0xFF && v >= 0){
 			insMode[0] = 'Z';
 		}
+		// value is known, the compiled expression is not needed
+		dropExpressions(f, expr);
 	}else{
 		clearErrors();
-		ins.expr = p - (struct Piece*)listBeg(f->pieces);
+		ins.expr = expr;
 	}
 
 	// skip to after expr
-	while(p->type != PT_LINE && p->type != PT_EXPR_DELIM){
+	while(pieceType(f, p) != PT_LINE && pieceType(f, p) != PT_EXPR_DELIM){
 		++p;
 	}
-	if(p->type == PT_EXPR_DELIM){
+	if(pieceType(f, p) == PT_EXPR_DELIM){
 		++p;
 	}
 
 	// find mode flags if any
 	int addidx = 1;
-	while(p->type != PT_LINE){
-		if(p->type != PT_STRING){
+	while(pieceType(f, p) != PT_LINE){
+		if(pieceType(f, p) != PT_STRING){
 			addErrorMessage("mode flags not a string");
-			return NULL;
+			return 0;
 		}
-		char* s = stringAt(p->stridx);
+		char* s = stringAt(pieceString(f, p));
 		for(int idx = 0; s[idx]; ++idx){
 			if(strchr("XYIN", s[idx])){
 				if(addidx == 3){
 					addErrorMessage("too many mode flags: %s", s);
-					return NULL;
+					return 0;
 				}
 				insMode[addidx++] = s[idx];
 			}else if(strchr("ZV", s[idx])){
@@ -343,7 +314,7 @@ struct Piece* getInsLine(struct Piece p[], struct Instruction* out, struct FileD
 				forceValue = true;
 			}else{
 				addErrorMessage("mode flags not recognized: %s", s);
-				return NULL;
+				return 0;
 			}
 		}
 		++p;
@@ -375,24 +346,41 @@ INS_NO_VAL:
 		if(insMode[1] == 0) insMode[1] = ' ';
 		if(insMode[2] == 0) insMode[2] = ' ';
 		addErrorMessage("could not determine addressing mode from flags: %c%c%c", insMode[0], insMode[1], insMode[2]);
-		return NULL;
+		return 0;
 	}
 
 	// for calculating branch offsets, POS + VAL = TPOS -> VAL = TPOS - POS
 	if(addrMode == AM_PCR){
-		if(!ins.expr){
+		if(ins.expr == EXPR_NONE){
 			ins.value -= memIdx + 2;
 		}else{
 			ins.value = memIdx + 2;
 		}
 	}
 	ins.opcode = opcodes[insName][addrMode] - 1;
+	ins.mode = addrMode;
 	if(insMode[0] == 'Z'){
 		ins.size = 2;
 	}else if(insMode[0] == 'V'){
 		ins.size = 3;
 	}
 
+	// values not known yet are placed after linking
+	if(ins.expr != EXPR_NONE){
+		struct Reloc r = {.expr = ins.expr, .offset = memIdx + 1, .kind = RK_WORD};
+		if(addrMode == AM_PCR){
+			r.kind = RK_BRANCH;
+		}else if(addrMode == AM_IM){
+			r.kind = RK_IMMEDIATE;
+		}else if(ins.size == 2){
+			r.kind = RK_ZERO_PAGE;
+		}else if(!forceValue && zeroPageMode(addrMode) != AM_NULL && opcodes[insName][zeroPageMode(addrMode)]){
+			// shrunk by sizeInstructions if the value turns out to be in zero page
+			r.kind = RK_ADDRESS;
+		}
+		listAdd(&f->relocs, &r, 1);
+	}
+
 	*out = ins;
 	return p;
 }
@@ -400,9 +388,58 @@ INS_NO_VAL:
 struct FileData newFileData(const char* name){
 	struct FileData f;
 	f.name = name;
-	f.pieces = listNew(sizeof(struct Piece), 100);
+	f.pieces.types = listNew(sizeof(uint8_t), 100);
+	f.pieces.values = listNew(sizeof(uint32_t), 100);
 	f.labels = listNew(sizeof(struct Label), 50);
 	f.instructions = listNew(sizeof(struct Instruction), 50);
+	f.relocs = listNew(sizeof(struct Reloc), 50);
 	f.commands = listNew(sizeof(struct Command), 50);
+	f.exprs = listNew(sizeof(struct Expr), 50);
+	f.code = listNew(sizeof(struct ExprOp), 100);
+	// handle 0 is EXPR_NONE
+	static const struct Expr none = {0};
+	listAdd(&f.exprs, &none, 1);
+	f.arena = newArena(1 << 16);
+	f.romSegment = -1;
+	f.ramSegment = -1;
 	return f;
 }
+
+void fileDataUseArena(struct FileData* f, size_t sourceSize){
+	// rough amounts per byte of source, the lists still grow if a file has more
+	size_t pieces = sourceSize / 4 + 16, lines = sourceSize / 16 + 16;
+	struct{
+		struct List* list;
+		size_t count;
+	} reserve[] = {
+		{&f->pieces.types, pieces},
+		{&f->pieces.values, pieces},
+		{&f->labels, lines / 2},
+		{&f->instructions, lines},
+		{&f->relocs, lines / 2},
+		{&f->commands, lines / 2},
+		{&f->exprs, lines},
+		{&f->code, lines * 2},
+	};
+	size_t bytes = 0;
+	for(int a = 0; a < sizeof(reserve) / sizeof(reserve[0]); ++a){
+		bytes += reserve[a].count * reserve[a].list->elementSize + 16;
+	}
+	arenaReserve(&f->arena, bytes);
+	for(int a = 0; a < sizeof(reserve) / sizeof(reserve[0]); ++a){
+		listUseArena(reserve[a].list, &f->arena);
+		listReserve(reserve[a].list, reserve[a].count);
+	}
+}
+
+void fileDataZero(struct FileData* f){
+	listZero(&f->pieces.types);
+	listZero(&f->pieces.values);
+	listZero(&f->labels);
+	listZero(&f->instructions);
+	listZero(&f->relocs);
+	listZero(&f->commands);
+	listZero(&f->exprs);
+	listZero(&f->code);
+	arenaZero(&f->arena);
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/inotify.h>
+#include "watch.h"
+#include "types.h"
+#include "utility.h"
+#include "error.h"
+#include "jobs.h"
+#include "link.h"
+#include "output.h"
+
+// editors save in several steps, changes are collected until none come for this long
+#define WATCH_QUIET_MS 20
+
+// image written by the last successful build
+static unsigned char lastImage[ADDRESS_SPACE];
+static bool haveImage = false;
+
+static double now(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// merge and link the scanned files in a child process and write the image if it changed
+// the scans of this process stay at relative addresses so changed files can replace theirs, and errors that exit only end the child
+// returns the number of bytes that changed, -1 if the build failed
+static int relink(const char* outputName){
+	int fds[2];
+	testError(pipe(fds), "failed to create pipe");
+	fflush(NULL);
+	pid_t pid = fork();
+	testError(pid < 0, "failed to fork");
+	if(!pid){
+		close(fds[0]);
+		mergeFiles();
+		int start, interrupt;
+		linkFiles(&start, &interrupt);
+		if(!haveImage || memcmp(memImage, lastImage, ADDRESS_SPACE)){
+			writeImage(outputName);
+		}
+		bool sent = write(fds[1], memImage, ADDRESS_SPACE) == ADDRESS_SPACE;
+		fflush(NULL);
+		_exit(sent ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	static unsigned char image[ADDRESS_SPACE];
+	size_t got = 0;
+	ssize_t n;
+	while(got < ADDRESS_SPACE && (n = read(fds[0], image + got, ADDRESS_SPACE - got)) > 0){
+		got += n;
+	}
+	close(fds[0]);
+	int status;
+	waitpid(pid, &status, 0);
+	if(!WIFEXITED(status) || WEXITSTATUS(status) || got != ADDRESS_SPACE){
+		return -1;
+	}
+
+	int changed = 0;
+	for(size_t a = 0; a < ADDRESS_SPACE; ++a){
+		changed += image[a] != lastImage[a];
+	}
+	if(!haveImage){
+		changed = ADDRESS_SPACE;
+	}
+	memcpy(lastImage, image, ADDRESS_SPACE);
+	haveImage = true;
+	return changed;
+}
+
+static void report(int changed, double start, const char* outputName){
+	double ms = (now() - start) * 1e3;
+	if(changed < 0){
+		printf("build failed (%.1f ms)\n", ms);
+	}else if(changed){
+		printf("wrote \"%s\": %d bytes changed (%.1f ms)\n", outputName, changed, ms);
+	}else{
+		printf("image unchanged (%.1f ms)\n", ms);
+	}
+	fflush(stdout);
+}
+
+void watchFiles(int jobs, const char* outputName){
+	int fd = inotify_init1(IN_CLOEXEC);
+	testError(fd < 0, "inotify_init1: %s", strerror(errno));
+
+	// directories are watched instead of files, editors often replace a file by renaming a new one over it
+	int* wds = malloc(sizeof(int) * fssize);
+	const char** bases = malloc(sizeof(char*) * fssize);
+	bool* changed = malloc(sizeof(bool) * fssize);
+	// files whose last rescan failed, no build is linked until each of them scans again
+	bool* broken = calloc(fssize, sizeof(bool));
+	testError(!wds || !bases || !changed || !broken, "watch list alloc fail");
+	for(int fn = 0; fn < fssize; ++fn){
+		const char* name = filesArray[fn].name;
+		const char* slash = strrchr(name, '/');
+		char dir[4096] = ".";
+		if(slash){
+			snprintf(dir, sizeof(dir), "%.*s", (int)(slash - name) + 1, name);
+		}
+		bases[fn] = slash ? slash + 1 : name;
+		wds[fn] = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+		testError(wds[fn] < 0, "failed to watch \"%s\": %s", dir, strerror(errno));
+	}
+
+	double start = now();
+	scanFiles(jobs);
+	report(relink(outputName), start, outputName);
+
+	// inotify events are aligned to their struct
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while(true){
+		memset(changed, 0, sizeof(bool) * fssize);
+		bool any = false;
+		int timeout = -1;
+		struct pollfd p = {.fd = fd, .events = POLLIN};
+		while(poll(&p, 1, timeout) > 0){
+			ssize_t len = read(fd, buf, sizeof(buf));
+			testError(len < 0 && errno != EINTR, "inotify read: %s", strerror(errno));
+			for(char* c = buf; c < buf + len;){
+				struct inotify_event* e = (void*)c;
+				for(int fn = 0; e->len && fn < fssize; ++fn){
+					if(e->wd == wds[fn] && !strcmp(e->name, bases[fn])){
+						changed[fn] = any = true;
+					}
+				}
+				c += sizeof(struct inotify_event) + e->len;
+			}
+			timeout = any ? WATCH_QUIET_MS : -1;
+		}
+		if(!any){
+			continue;
+		}
+
+		start = now();
+		for(int fn = 0; fn < fssize; ++fn){
+			if(!changed[fn]){
+				continue;
+			}
+			// a file being replaced can be missing for a moment, its last scan is kept until it is back
+			int check = open(filesArray[fn].name, O_RDONLY);
+			if(check < 0){
+				fprintf(stderr, "can't read \"%s\": %s\n", filesArray[fn].name, strerror(errno));
+				continue;
+			}
+			close(check);
+			printf("rescanning \"%s\"\n", filesArray[fn].name);
+			broken[fn] = !rescanFile(fn);
+		}
+		bool ok = true;
+		for(int fn = 0; fn < fssize; ++fn){
+			if(broken[fn] && !changed[fn]){
+				fprintf(stderr, "\"%s\" still has errors\n", filesArray[fn].name);
+			}
+			ok = ok && !broken[fn];
+		}
+		report(ok ? relink(outputName) : -1, start, outputName);
+	}
+}
@@ -0,0 +1,21 @@
+; the body of a loop is measured with its label as both addresses, the exit path does not count
+.label __START
+ldx 10, i
+.label wl
+dex
+bne wl
+.label after
+jsr tail
+.label spin
+bra spin
+.cycles wl, wl, 5
+; the path through the jsr and the routine it calls is counted up to spin, the rts of the routine does not end it
+.cycles after, spin, 20
+.label tail
+lda 0x10
+beq done
+lda 0x11
+.label done
+rts
+.label __INTERRUPT
+rti